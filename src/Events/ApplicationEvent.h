@@ -9,7 +9,7 @@ namespace viz {
 		static eventType GetStaticType() { return eventType::windowClose; }
 		eventType getEventType() const override { return eventType::windowClose; }
 		eventCategory getEventCat() const override { return eventCategory::eventCatApp; }
-		EventData* getData() const override { return NULL; }
+		const EventData* getData() const override { return NULL; }
 
 		std::string toString() const override {
 			return "windowEventClose";
@@ -19,29 +19,26 @@ namespace viz {
 	class windowEventResize : public event{
 	public:
 		windowEventResize(const unsigned int&& width, const unsigned int&& height) {
-			windowSize = new EventData;
-			windowSize->uintPairedData = { width, height };
+			windowSize.uintPairedData = { width, height };
 		}
 
 		windowEventResize(const unsigned int& width, const unsigned int& height) {
-			windowSize = new EventData;
-			windowSize->uintPairedData = { width, height };
+			windowSize.uintPairedData = { width, height };
 		}
 
 		static eventType GetStaticType() { return eventType::windowResize; }
 		eventType getEventType() const override { return eventType::windowResize;}
 		eventCategory getEventCat() const override { return eventCategory::eventCatApp; }
-		EventData* getData() const override { return windowSize; }
+		const EventData* getData() const override { return &windowSize; }
 
 		std::string toString() const override{
 			std::stringstream ss;
-			ss << "windowEventResize: (" << windowSize->uintPairedData.first << ", " << windowSize->uintPairedData.second << ")\n";
+			ss << "windowEventResize: (" << windowSize.uintPairedData.first << ", " << windowSize.uintPairedData.second << ")\n";
 			return ss.str();
 		}
 
-		~windowEventResize() override {delete windowSize;}
 	private:
-		EventData* windowSize;
+		EventData windowSize;
 	};
 
 	class appRender : public event {
@@ -50,7 +47,7 @@ namespace viz {
 		static eventType GetStaticType() { return eventType::appRender; }
 		eventType getEventType() const override { return eventType::appRender; }
 		eventCategory getEventCat() const override { return eventCategory::eventCatApp; }
-		EventData* getData() const override { return NULL; }
+		const EventData* getData() const override { return NULL; }
 
 		std::string toString() const override {
 			return "applicationRender";
@@ -10,7 +10,7 @@ namespace viz {
 		appUpdate, appRender,
 		keyPress, keyRelease,
 		mouseButtonPress, mouseButtonRelease, mouseMove, mouseScroll,
-		particleHit
+		hitSummary
 	};
 
 	enum eventCategory {
@@ -22,6 +22,8 @@ namespace viz {
 		eventCatParticle
 	};
 
+	//Events hold their EventData by value: nothing to free, and copying an event copies its data.
+	//getData() points into the event and is valid for as long as the event is
 	struct EventData {
 		EventData() = default;
 		std::pair<float, float> floatPairedData;
@@ -37,7 +39,7 @@ namespace viz {
 
 		virtual eventType getEventType() const = 0;
 		virtual eventCategory getEventCat() const = 0;
-		virtual EventData* getData()const  = 0;
+		virtual const EventData* getData() const = 0;
 
 		virtual std::string toString() const = 0;
 
@@ -9,30 +9,28 @@ namespace viz {
 	class keyEvent : public event{
 	public:
 		void setKeyPressed(const key::keyCodes& key) {
-			keyPressed->keyButton = key;
+			keyPressed.keyButton = key;
 		}
 		
 		key::keyCodes getKeyPressed() const {
-			return keyPressed->keyButton;
+			return keyPressed.keyButton;
 		}
 
 		virtual eventType getEventType() const = 0;
-		EventData* getData() const override { return keyPressed; }
+		const EventData* getData() const override { return &keyPressed; }
 
 		eventCategory getEventCat() const override {
 			return eventCategory::eventCatKey;
 		}
 
-		virtual ~keyEvent() {
-			delete keyPressed;
-		};
+		virtual ~keyEvent() = default;
 
 	protected:
-		keyEvent(const key::keyCodes& key) { keyPressed = new EventData; keyPressed->keyButton = key;  }
-		keyEvent(const key::keyCodes&& key) { keyPressed = new EventData; keyPressed->keyButton = key; }
-		keyEvent() { keyPressed = new EventData; }
+		keyEvent(const key::keyCodes& key) { keyPressed.keyButton = key;  }
+		keyEvent(const key::keyCodes&& key) { keyPressed.keyButton = key; }
+		keyEvent() = default;
 	private:
-		EventData* keyPressed;
+		EventData keyPressed;
 	};
 	
 
@@ -3,29 +3,50 @@
 
 #include "Event.h"
 
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
 namespace viz{
-    class ParticleHit : public event {
+    //All hits of one frame in a single event, instead of an event per hit. Detector owns one and
+    //refills it every frame, so the vectors keep their capacity; handlers only borrow it for the
+    //duration of the callback and must copy what they want to keep.
+    class HitSummary : public event {
         public:
-            ParticleHit(std::string name, unsigned int hits, unsigned int row, unsigned int col){
-                data = new EventData;
-                data->stringUIntPairedData = std::make_pair(name, hits);
-                data->uintPairedData = std::make_pair(row, col);
-            }
+            struct Sample{
+                std::uint16_t chipId, row, col;
+            };
+
+            std::vector<std::string> chipNames;     //by chip id, set once
+            std::vector<std::uint32_t> chipHits;    //new this frame, by chip id
+            std::vector<std::uint64_t> chipTotals;  //since the start of the run, by chip id
+            std::vector<Sample> samples;            //the first few hits of the frame, may be empty
+
+            //data.uintPairedData: (hits this frame, chips that saw any)
+            void setTotals(unsigned int hits, unsigned int chips) { data.uintPairedData = std::make_pair(hits, chips); }
+            unsigned int getHits() const { return data.uintPairedData.first; }
 
-            static eventType GetStaticType() { return eventType::particleHit; }
-            eventType getEventType() const override { return eventType::particleHit; }
+            static eventType GetStaticType() { return eventType::hitSummary; }
+            eventType getEventType() const override { return eventType::hitSummary; }
             eventCategory getEventCat() const override { return eventCategory::eventCatParticle; }
-            EventData* getData() const override { return data; }
+            const EventData* getData() const override { return &data; }
 
             std::string toString() const override {
                 std::stringstream ss;
-                ss << data->stringUIntPairedData.first << " Hit: at (" << data->uintPairedData.first << ", " << data->uintPairedData.second << ") with " << data->stringUIntPairedData.second << " total hits";
+                ss << getHits() << " hits on " << data.uintPairedData.second << " chips:";
+                for(std::size_t i = 0; i < chipHits.size(); i++){
+                    if(chipHits[i] > 0)
+                        ss << " " << chipNames[i] << " +" << chipHits[i] << " (" << chipTotals[i] << ")";
+                }
+                for(const Sample& s : samples)
+                    ss << " | " << chipNames[s.chipId] << " at (" << s.row << ", " << s.col << ")";
                 return ss.str();
             }
         private:
-            EventData* data;
+            EventData data;
     };
 }
 
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,26 @@
 #include "Camera.h"
 
 namespace viz{
+    Frustum::Frustum(const glm::mat4& viewProj){
+        glm::vec4 rows[4];
+        for(int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        for(int i = 0; i < 3; i++){
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+    }
+
+    bool Frustum::intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const{
+        //the box is outside if even its corner furthest along a plane's normal is behind it
+        for(const glm::vec4& plane : planes){
+            glm::vec3 corner(plane.x > 0.0f ? boxMax.x : boxMin.x, plane.y > 0.0f ? boxMax.y : boxMin.y, plane.z > 0.0f ? boxMax.z : boxMin.z);
+            if(glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
     Camera::Camera(){
         data.projection = glm::mat4(1.0f);
         data.orientation = glm::mat4(1.0f);
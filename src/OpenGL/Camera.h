@@ -18,6 +18,16 @@ namespace viz{
         float zoom, sensitivity;
     };
 
+    //View volume as six planes (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside,
+    //taken from the rows of a view-projection matrix (Gribb and Hartmann)
+    struct Frustum{
+        glm::vec4 planes[6];
+
+        explicit Frustum(const glm::mat4& viewProj);
+        //Conservative: true for every box inside or crossing the frustum, and for a few just outside its corners
+        bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+    };
+
     class Camera{
         public:
             bool cameraLocked = false;
@@ -45,6 +55,7 @@ namespace viz{
 
             glm::mat4 getView() const;
             glm::mat4 getProj() const;
+            Frustum getFrustum() const { return Frustum(getProj() * getView()); }
         private:
             CamData data;
             float t = 0.0f;
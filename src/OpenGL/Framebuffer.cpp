@@ -26,6 +26,7 @@ namespace viz{
         m_width = width;
         m_height = height;
         m_init = true;
+        createTransparentTargets(width, height);
     }
 
     void Framebuffer::init(int width, int height){
@@ -57,9 +58,65 @@ namespace viz{
             m_width = width;
             m_height = height;
             m_init = true;
+            createTransparentTargets(width, height);
         }
     }
 
+    //accumulation: premultiplied colour and alpha times the depth weight, summed (RGBA16F to take the weights);
+    //revealage: product of (1 - alpha), one channel
+    void Framebuffer::createTransparentTargets(int width, int height){
+        if(!isTransparencySupported())
+            return;
+
+        if(m_oitId == 0){
+            glGenFramebuffers(1, &m_oitId);
+            glGenTextures(1, &m_accumTexId);
+            glGenTextures(1, &m_revealTexId);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, m_accumTexId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindTexture(GL_TEXTURE_2D, m_revealTexId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        GLint drawFBOid = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFBOid);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_oitId);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumTexId, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_revealTexId, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo);
+            const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, buffers);
+            if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                m_appLogger->error("Transparency framebuffer is incomplete");
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFBOid);
+    }
+
+    void Framebuffer::beginTransparent(){
+        glBindFramebuffer(GL_FRAMEBUFFER, m_oitId);
+        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const GLfloat one[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, one);
+
+        glEnable(GL_BLEND);
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        glDepthMask(GL_FALSE);
+    }
+
+    void Framebuffer::endTransparent(){
+        glDepthMask(GL_TRUE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+    }
+
     void Framebuffer::resize(int width, int height){
         GLint drawFBOid = 0, readFBOid = 0;
         glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFBOid);
@@ -78,6 +135,7 @@ namespace viz{
 
             glBindTexture(GL_TEXTURE_2D, 0);
             glBindTexture(GL_TEXTURE_2D, 0);
+            createTransparentTargets(width, height);
         glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFBOid);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, readFBOid);
         
@@ -87,6 +145,11 @@ namespace viz{
     
 
     Framebuffer::~Framebuffer(){
+        if(m_oitId != 0){
+            glDeleteTextures(1, &m_accumTexId);
+            glDeleteTextures(1, &m_revealTexId);
+            glDeleteFramebuffers(1, &m_oitId);
+        }
         glDeleteTextures(1, &m_texid);
         glDeleteRenderbuffers(1, &m_rbo);
         glDeleteFramebuffers(1, &m_id);
@@ -6,12 +6,23 @@
 
 namespace viz
 {
+    //Colour target plus the two targets of weighted blended order independent transparency
+    //(McGuire and Bavoil, JCGT 2013): translucent surfaces are drawn in any order into a
+    //weighted colour sum (accumulation) and the product of their transparencies (revealage),
+    //and compositeTransparent() then resolves them over the colour target. Both framebuffers
+    //share the depth buffer, so opaque geometry drawn first still hides what is behind it.
     class Framebuffer{
         private:
             GLuint m_id, m_rbo, m_texid;
+            GLuint m_oitId = 0, m_accumTexId = 0, m_revealTexId = 0;
             std::uint16_t m_width, m_height;
             bool m_init;
+
+            void createTransparentTargets(int width, int height);
         public:
+            //Per target blending (glBlendFunci) needs GL 4.0
+            static bool isTransparencySupported() { return GLAD_GL_VERSION_4_0; }
+
             Framebuffer(int width, int height);
 
             void init(int width, int height);
@@ -21,6 +32,14 @@ namespace viz
             inline std::uint16_t getWidth() {return m_width;}
             inline std::uint16_t getHeight() {return m_height;}
             inline GLuint getTexID() {return m_texid; }
+            inline GLuint getAccumTexID() {return m_accumTexId; }
+            inline GLuint getRevealTexID() {return m_revealTexId; }
+
+            //Binds and clears the transparency targets and sets up their blending; draw every
+            //translucent surface after this, without depth writes
+            void beginTransparent();
+            //Back to the colour target with the default blending, ready for the composite pass
+            void endTransparent();
 
             void resize(int width, int height);
 
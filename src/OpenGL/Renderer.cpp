@@ -23,6 +23,77 @@ namespace viz{
         "   fragOut = uIsInstanced ? aInstanceFrag : aFrag;\n"
         "}\0";
 
+    //Hits (HitMesh): the position of the hit from its slot's entry in the position buffer,
+    //orientation and size from the chip table, six texels per chip (ChipTableEntry), and the
+    //colour from the age of the hit. Expired hits, empty slots and hits of
+    //chips not drawn in full are moved outside the clip volume, so the rasterizer drops them
+    const char* hitVertexShaderSource="#version 330 core\n"
+        "layout (location = 0) in vec3 aPos;\n"
+        "layout (location = 2) in uvec2 aHit;\n" //row | col << 16, chip
+        "layout (location = 3) in float aSpawnTime;\n"
+        "layout (location = 4) in vec3 aWorld;\n"
+
+        "uniform samplerBuffer uChips;\n"
+        "uniform mat4 uView;\n"
+        "uniform mat4 uProj;\n"
+        "uniform float uTime;\n"
+        "uniform float uLifetime;\n"
+        "uniform vec4 uRampStart;\n" //colour of a new hit
+        "uniform vec4 uRampEnd;\n"   //...and of one at the end of its lifetime
+
+        "out vec4 fragOut;\n"
+
+        "void main()\n"
+        "{\n"
+        "   float age = uTime - aSpawnTime;\n"
+        "   int base = int(aHit.y) * 6;\n"
+        "   vec4 origin = texelFetch(uChips, base);\n"
+        "   if(age >= uLifetime || origin.w == 0.0){\n"
+        "       gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+        "       fragOut = vec4(0.0);\n"
+        "       return;\n"
+        "   }\n"
+        "   mat3 basis = mat3(texelFetch(uChips, base + 3).xyz, texelFetch(uChips, base + 4).xyz, texelFetch(uChips, base + 5).xyz);\n"
+        "   gl_Position = uProj * uView * vec4(basis * aPos + aWorld, 1.0);\n"
+        "   float ratio = clamp(1.0 - age / uLifetime, 0.0, 1.0);\n"
+        "   fragOut = mix(uRampEnd, uRampStart, ratio);\n"
+        "}\0";
+
+    //Hits as points (HitMesh::renderPoints): the same inputs as above for one vertex per hit,
+    //as wide on screen as a pixel of its chip (the length of rowStep) and at least one pixel
+    const char* hitPointVertexShaderSource="#version 330 core\n"
+        "layout (location = 2) in uvec2 aHit;\n" //row | col << 16, chip
+        "layout (location = 3) in float aSpawnTime;\n"
+        "layout (location = 4) in vec3 aWorld;\n"
+
+        "uniform samplerBuffer uChips;\n"
+        "uniform mat4 uView;\n"
+        "uniform mat4 uProj;\n"
+        "uniform float uPointScale;\n" //screen pixels per unit of size / distance
+        "uniform float uTime;\n"
+        "uniform float uLifetime;\n"
+        "uniform vec4 uRampStart;\n"
+        "uniform vec4 uRampEnd;\n"
+
+        "out vec4 fragOut;\n"
+
+        "void main()\n"
+        "{\n"
+        "   float age = uTime - aSpawnTime;\n"
+        "   int base = int(aHit.y) * 6;\n"
+        "   vec4 origin = texelFetch(uChips, base);\n"
+        "   if(age >= uLifetime || origin.w == 0.0){\n"
+        "       gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+        "       gl_PointSize = 1.0;\n"
+        "       fragOut = vec4(0.0);\n"
+        "       return;\n"
+        "   }\n"
+        "   gl_Position = uProj * uView * vec4(aWorld, 1.0);\n"
+        "   gl_PointSize = max(1.0, uPointScale * length(texelFetch(uChips, base + 1).xyz) / gl_Position.w);\n"
+        "   float ratio = clamp(1.0 - age / uLifetime, 0.0, 1.0);\n"
+        "   fragOut = mix(uRampEnd, uRampStart, ratio);\n"
+        "}\0";
+
     const char* geometryShaderSource="version 330 compatibility\n"
         "layout (triangles_adjacency) in;\n"
         "layout (line_strip) out\n;"
@@ -42,8 +113,93 @@ namespace viz{
         "    FragColor = fragOut;\n"
         "}\0";
 
+    //Occupancy heatmap (OccupancyMap): a quad per chip, coloured by log(1 + hits) of each pixel
+    const char* heatmapVertexShaderSource="#version 330 core\n"
+        "layout (location = 0) in vec2 aPos;\n"
+
+        "uniform mat4 uModel;\n"
+        "uniform mat4 uView;\n"
+        "uniform mat4 uProj;\n"
+
+        "out vec2 texCoord;\n"
+
+        "void main()\n"
+        "{\n"
+        "   gl_Position = uProj * uView * uModel * vec4(aPos, 0.0, 1.0);\n"
+        "   texCoord = aPos * 0.5 + 0.5;\n"
+        "}\0";
+
+    const char* heatmapFragmentShaderSource="#version 330 core\n"
+        "in vec2 texCoord;\n"
+        "out vec4 FragColor;\n"
+
+        "uniform usampler2D uCounts;\n"
+        "uniform float uLogMax;\n" //log(1 + the highest count of any pixel)
+
+        "const vec3 ramp[5] = vec3[5](vec3(0.267, 0.005, 0.329), vec3(0.229, 0.322, 0.545), vec3(0.128, 0.567, 0.551),\n"
+        "                             vec3(0.369, 0.789, 0.383), vec3(0.993, 0.906, 0.144));\n"
+
+        "void main()\n"
+        "{\n"
+        "    float count = float(texture(uCounts, texCoord).r);\n"
+        "    float t = uLogMax > 0.0 ? 4.0 * log(1.0 + count) / uLogMax : 0.0;\n"
+        "    int i = min(int(t), 3);\n"
+        "    FragColor = vec4(mix(ramp[i], ramp[i + 1], t - float(i)), 1.0);\n"
+        "}\0";
+
+    //Transparency pass (Framebuffer::beginTransparent): weight from McGuire and Bavoil, eq. 10,
+    //so nearer and more opaque surfaces dominate the average colour
+    const char* transparentFragmentShaderSource="#version 330 core\n"
+        "in vec4 fragOut;\n"
+        "layout (location = 0) out vec4 accum;\n"
+        "layout (location = 1) out float reveal;\n"
+
+        "void main()\n"
+        "{\n"
+        "    float a = fragOut.a;\n"
+        "    float w = clamp(pow(min(1.0, a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);\n"
+        "    accum = vec4(fragOut.rgb * a, a) * w;\n"
+        "    reveal = a;\n"
+        "}\0";
+
+    //Full screen triangle from gl_VertexID, no vertex buffer
+    const char* compositeVertexShaderSource="#version 330 core\n"
+        "void main()\n"
+        "{\n"
+        "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+        "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+        "}\0";
+
+    //Weighted average colour of the translucent surfaces, covering 1 - revealage of what is below
+    const char* compositeFragmentShaderSource="#version 330 core\n"
+        "uniform sampler2D uAccum;\n"
+        "uniform sampler2D uReveal;\n"
+        "out vec4 FragColor;\n"
+
+        "void main()\n"
+        "{\n"
+        "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+        "    float reveal = texelFetch(uReveal, p, 0).r;\n"
+        "    if(reveal >= 1.0)\n"
+        "        discard;\n"
+        "    vec4 accum = texelFetch(uAccum, p, 0);\n"
+        "    FragColor = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - reveal);\n"
+        "}\0";
+
     Renderer::Renderer(int width, int height){
-        m_Shaders.emplace_back(false, "default", viz::vertexShaderSource, viz::fragmentShaderSource);
+        //Chips and hits are all translucent and go through the transparency targets when there are any
+        m_oit = Framebuffer::isTransparencySupported();
+        const char* fragmentSource = m_oit ? viz::transparentFragmentShaderSource : viz::fragmentShaderSource;
+        if(!m_oit)
+            m_appLogger->warn("GL 4.0 is not available, translucent objects are blended in draw order");
+
+        m_Shaders.reserve(5); //Shader owns its GL program, so the vector must not reallocate
+        m_Shaders.emplace_back(false, "default", viz::vertexShaderSource, fragmentSource);
+        m_Shaders.emplace_back(false, "hits", viz::hitVertexShaderSource, fragmentSource);
+        m_Shaders.emplace_back(false, "composite", viz::compositeVertexShaderSource, viz::compositeFragmentShaderSource);
+        m_Shaders.emplace_back(false, "heatmap", viz::heatmapVertexShaderSource, viz::heatmapFragmentShaderSource);
+        m_Shaders.emplace_back(false, "hitPoints", viz::hitPointVertexShaderSource, fragmentSource);
+        glGenVertexArrays(1, &m_screenVAO);
         m_Cameras.emplace(std::make_pair("Main", Camera())); m_currCam = "Main";
         m_framebuffer = std::make_unique<Framebuffer>(width, height);
         m_detector = std::make_unique<Detector>();
@@ -58,6 +214,10 @@ namespace viz{
         m_activeShaderNum = 0;
     }
 
+    Renderer::~Renderer(){
+        glDeleteVertexArrays(1, &m_screenVAO);
+    }
+
     void Renderer::resize(int width, int height){
         m_framebuffer->resize(width, height);
         for(auto& pair : m_Cameras)
@@ -75,14 +235,52 @@ namespace viz{
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             
             auto it = m_Cameras.find(m_currCam);
-            m_Shaders[0].setMat4("uView", it->second.getView());
-            m_Shaders[0].setMat4("uProj", it->second.getCamData().projection);
+            for(const Shader& shader : m_Shaders){
+                shader.use();
+                shader.setMat4("uView", it->second.getView());
+                shader.setMat4("uProj", it->second.getCamData().projection);
+                shader.setFloat("uPointScale", 0.5f * getHeight() * it->second.getCamData().projection[1][1]);
+            }
 
-            m_detector->render(m_Shaders[0]);
+            m_detector->renderOpaque(m_Shaders[3]);
+
+            if(m_oit){
+                m_framebuffer->beginTransparent();
+                m_detector->render(m_Shaders[0], m_Shaders[1], m_Shaders[4]);
+                m_framebuffer->endTransparent();
+                compositeTransparent();
+            }
+            else{
+                glDepthMask(GL_FALSE);
+                m_detector->render(m_Shaders[0], m_Shaders[1], m_Shaders[4]);
+                glDepthMask(GL_TRUE);
+            }
 
         m_framebuffer->unbind();
     }
 
+    //Resolves the transparency targets over the colour target, one full screen triangle
+    void Renderer::compositeTransparent(){
+        glDisable(GL_DEPTH_TEST);
+        const Shader& composite = m_Shaders[2];
+        composite.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_framebuffer->getAccumTexID());
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_framebuffer->getRevealTexID());
+        composite.setInt("uAccum", 0);
+        composite.setInt("uReveal", 1);
+
+        glBindVertexArray(m_screenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
     void Renderer::setCurrentCamera(std::string name){
         auto it = m_Cameras.find(name);
         if(it != m_Cameras.end())
@@ -108,9 +306,4 @@ namespace viz{
         if(it != m_Cameras.end())
             m_Cameras.erase(it);
     }
-
-    void Renderer::sortTransparentObjects(){
-        auto it = m_Cameras.find(m_currCam);
-        m_detector->sortTransparent(it->second);
-    }
 }
\ No newline at end of file
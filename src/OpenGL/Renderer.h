@@ -17,6 +17,7 @@ namespace viz{
     class Renderer{
         public:
             Renderer(int width, int height);
+            ~Renderer();
 
             void init();
             void resize(int width, int height);
@@ -38,16 +39,19 @@ namespace viz{
             const std::shared_ptr<Detector> getDetector() const { return m_detector; }
             
             void render();
-            void sortTransparentObjects();
 
             double getDelTime() const { return delTime; }
         private:
+            void compositeTransparent();
+
             friend class Application;
             std::shared_ptr<Detector> m_detector;
             std::unique_ptr<Framebuffer> m_framebuffer;
 
             std::uint8_t m_activeShaderNum;
             std::vector<Shader> m_Shaders;
+            bool m_oit = false;     //translucent objects go through the transparency targets
+            GLuint m_screenVAO = 0; //empty, for the composite pass
 
             std::string m_currCam;
             std::map<std::string, Camera> m_Cameras;
@@ -1,9 +1,10 @@
 #include "OpenGL/Scene/Detector.h"
 
+#include <cmath>
 #include <random>
 
 namespace {
-    auto log = logging::make_log("Detector");
+    auto logger = logging::make_log("Detector");
 }
 
 namespace viz{
@@ -56,10 +57,24 @@ namespace viz{
     
     Detector::Detector(){
         CubeMesh = SimpleMesh(CubeVertices, CubeIndices, true);
-        ParticlesContainer.resize(10000);
+        m_hitMesh = HitMesh(HitVertices, CubeIndices);
         m_cli; 
     }
 
+    Detector::~Detector(){
+        m_procRun = false;
+        if(m_procThread.joinable())
+            m_procThread.join();
+        if(m_bunchesOverwritten > 0)
+            logger->warn("{} reconstructed bunches were overwritten before leaving the {} s window, consider a larger event_buffer_size", m_bunchesOverwritten, m_eventWindow);
+        if(m_hitsDropped > 0)
+            logger->warn("{} hits were dropped before their lifetime ended, consider a larger instance_budget (now {})", m_hitsDropped, m_hits.getMaxCapacity());
+        if(m_hitsRejected > 0)
+            logger->warn("{} hits were outside their chip and skipped", m_hitsRejected);
+        if(m_hitsDecimated > 0)
+            logger->info("{} hits were not drawn to stay within the instance budget of {}", m_hitsDecimated, m_hits.getMaxCapacity());
+    }
+
     void Detector::init(const std::shared_ptr<VisualizerCli>& cli){
         m_cli = cli;
 
@@ -79,6 +94,7 @@ namespace viz{
             tempChip.scale = glm::vec3(size[0] / 2.0f, size[1] / 2.0f, size[2] / 2.0f);
             tempChip.maxRows = rowcol[0]; tempChip.maxCols = rowcol[1];
             tempChip.hits = 0;
+            computeChipTransform(tempChip);
 
             glm::mat4 tempTfm = transform(tempChip.scale, tempChip.eulerRot, tempChip.pos, false);
             
@@ -90,168 +106,456 @@ namespace viz{
             tempPart.color = glm::vec4(0.3921f, 0.3921f, 0.3921f, 0.25f);
             tempPart.is_immortal = true;
             tempPart.lifetime = 100.0f;
-            tempPart.ndcDepth = 0.0f;
-            ParticlesContainer[FindUnusedParticle()] = tempPart;
+            tempPart.chipId = i;
+            m_chipParticles.push_back(tempPart);
+            m_occupancy.addChip(tempChip.maxRows, tempChip.maxCols, tempTfm);
         };
+        m_chipLod.assign(m_chips.size(), ChipLod::Full);
+        uploadChipTable();
+        m_liveParticles.assign(m_chips.size(), 0);
+        m_chipHits.assign(m_chips.size(), 0);
+        for(HitTally* tally : {&m_tally, &m_pendingTally}){
+            tally->chipHits.assign(m_chips.size(), 0);
+            tally->chipTotals.assign(m_chips.size(), 0);
+        }
+        for(const Chip& chip : m_chips)
+            m_summary.chipNames.push_back(chip.name);
+
+        json vizConfig = cli->getMasterConfig().value("viz_config", json::object());
+        // hit slots: "particle_capacity" up front, growing on demand up to "instance_budget" (0: no limit).
+        // "overflow" says what gives once the budget is used up: "drop_oldest" or "decimate"
+        std::size_t particleCapacity = std::max<std::size_t>(1, vizConfig.value("particle_capacity", (std::size_t)10000));
+        std::size_t instanceBudget = vizConfig.value("instance_budget", (std::size_t)1000000);
+        if(instanceBudget != 0 && particleCapacity > instanceBudget)
+            logger->warn("particle_capacity {} exceeds the instance_budget, reserving {} hit slots", particleCapacity, instanceBudget);
+        m_hits = SlotAllocator<HitInstance>(particleCapacity, instanceBudget); //no hit has been spawned yet
+        std::string overflow = vizConfig.value("overflow", std::string("drop_oldest"));
+        if(overflow == "decimate")
+            m_overflow = OverflowPolicy::Decimate;
+        else if(overflow != "drop_oldest")
+            logger->warn("Unknown overflow policy \"{}\", using drop_oldest", overflow);
+
+        // "lod_pixels": chips smaller than this on screen (in pixels) show their heatmap instead of their hits; 0 turns it off
+        m_lodPixels = vizConfig.value("lod_pixels", m_lodPixels);
+
+        // "point_sprite_threshold": above this many live hits they are drawn as points instead of cubes; 0: always cubes
+        m_pointThreshold = vizConfig.value("point_sprite_threshold", m_pointThreshold);
+
+        // "hit_samples": hits per frame listed individually in the hit summary, besides the per chip counts
+        m_hitSamples = vizConfig.value("hit_samples", m_hitSamples);
+
+        // "display": "hits" (default) or "heatmap"
+        std::string display = vizConfig.value("display", std::string("hits"));
+        if(display == "heatmap")
+            m_displayMode = DisplayMode::Heatmap;
+        else if(display != "hits")
+            logger->warn("Unknown display mode \"{}\", using hits", display);
+
+        // "stream_buffers": instances go through persistently mapped buffers (GL 4.4) instead of re-uploads
+        if(vizConfig.value("stream_buffers", true)){
+            if(!CubeMesh.setStreaming(true) || !m_hitMesh.setStreaming(true))
+                logger->warn("GL 4.4 is not available, instance buffers are re-uploaded instead of streamed");
+        }
+
+        // "compute_transform": hit positions from a compute shader (GL 4.3) instead of the CPU;
+        // "verify_transform": compare the two on the first hits written
+        if(vizConfig.value("compute_transform", true) && !m_hitMesh.setCompute(true))
+            logger->warn("GL 4.3 is not available, hit positions are computed on the CPU");
+        if(vizConfig.value("verify_transform", false))
+            m_hitMesh.verifyNextWrite();
+
+        if(vizConfig.contains("snapshot_time"))
+            m_snapshotInterval = std::chrono::microseconds((long)(1000 * vizConfig["snapshot_time"].get<float>()));
+
+        // "reconstruct": draw event-built bunches instead of raw per-FE hits, keeping the last
+        // "event_window" seconds of bunches (at most "event_buffer_size" of them)
+        m_reconstruct = vizConfig.value("reconstruct", false);
+        m_eventWindow = vizConfig.value("event_window", particleLifetime);
+        if(vizConfig.contains("event_buffer_size"))
+            eventBuffer = CircularBuffer<ReconstructedBunch, float>((std::size_t)vizConfig["event_buffer_size"]);
+        m_startTime = std::chrono::steady_clock::now();
+
+        m_procRun = true;
+        m_procThread = std::thread(&Detector::processLoop, this);
         
-        m_appLogger->info("Detector initialized with {0} chips", m_chips.size());
+        m_appLogger->info("Detector initialized with {0} chips, hit processing every {1} us", m_chips.size(), m_snapshotInterval.count());
     }
 
     void Detector::update(const Camera& cam, float dTime){
-        if(!m_cli->isRunning())
-            return;
-        
-        m_nfe = 0;
-        m_size = 0;
+        {
+            //copies into vectors of the same size, so nothing is allocated after the first frame
+            std::lock_guard<std::mutex> lock(m_tallyMutex);
+            m_summary.chipHits = m_pendingTally.chipHits;
+            m_summary.chipTotals = m_pendingTally.chipTotals;
+            m_summary.samples = m_pendingTally.samples;
+            std::fill(m_pendingTally.chipHits.begin(), m_pendingTally.chipHits.end(), 0);
+            m_pendingTally.samples.clear();
+        }
+        unsigned int frameHits = 0, frameChips = 0;
+        for(std::uint32_t hits : m_summary.chipHits){
+            frameHits += hits;
+            frameChips += hits > 0;
+        }
+        if(frameHits > 0){
+            m_summary.setTotals(frameHits, frameChips);
+            m_summary.handled = false;
+            eventCallback(m_summary);
+        }
+
+        uploadNewHits();
+        updateVisibility(cam);
+        if(m_displayMode == DisplayMode::Heatmap || m_tileChips > 0)
+            m_occupancy.upload();
+
+        if(m_snapshots.update()){
+            DetectorSnapshot& snap = m_snapshots.front();
+            m_chipInstances.swap(snap.instances); //the old vector goes back to the producer with its capacity
+            m_chipsDirty = true;
+
+            m_liveHits = 0;
+            for(int i = 0; i < snap.liveParticles.size(); i++){
+                m_cli->setConsumerMemory(i, snap.liveParticles[i] * 2 * sizeof(HitInstance), snap.liveParticles[i]); //slot and GPU copy
+                m_liveHits += snap.liveParticles[i];
+            }
+
+            if(m_pointThreshold == 0)
+                m_drawPoints = false;
+            else if(m_liveHits > m_pointThreshold)
+                m_drawPoints = true;
+            else if(m_liveHits < m_pointThreshold * 9 / 10)
+                m_drawPoints = false;
+        }
+
+        if(m_chipsDirty){
+            CubeMesh.m_instances.clear();
+            for(std::size_t i = 0; i < m_chipInstances.size(); i++){
+                if(m_chipLod[i] != ChipLod::Hidden)
+                    CubeMesh.m_instances.push_back(m_chipInstances[i]);
+            }
+            CubeMesh.updateInstances();
+            m_chipsDirty = false;
+        }
+
+        // m_cli->state = CLIstate::RECONSTRUCT;
+        // std::this_thread::sleep_for(std::chrono::nanoseconds(25));
+        // auto test = m_cli->getReconstructedBunch();
+        // for(int i = 0; i < test->size(); i++){
+        //     nHits += (*test)[i].nHits;
+        // }
+        // std::cout << "Detector hits total: " << nHits << std::endl;
+
+    }
+
+    void Detector::processLoop(){
+        m_cli->pinCurrentThread("builder"); //this thread drains the FEs and builds what gets drawn
+
+        auto last = std::chrono::steady_clock::now();
+        auto nextPublish = last;
+
+        while(m_procRun){
+            if(!m_cli->isRunning()){
+                std::this_thread::sleep_for(m_snapshotInterval);
+                last = nextPublish = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            // ingest whatever arrives until the next snapshot is due
+            auto now = std::chrono::steady_clock::now();
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(nextPublish - now);
+            bool ready = m_cli->waitForData(std::max(wait, std::chrono::microseconds(0)));
+            if(m_reconstruct)
+                ingestBunches(); //also without new data: open bunches may have timed out
+            else if(ready)
+                ingestHits();
+
+            now = std::chrono::steady_clock::now();
+            if(now < nextPublish)
+                continue;
+
+            buildSnapshot(std::chrono::duration<float>(now - last).count());
+            last = now;
+            nextPublish = now + m_snapshotInterval;
+        }
+    }
 
-        std::this_thread::sleep_for(std::chrono::nanoseconds(25));
+    void Detector::ingestHits(){
         for(int i = 0; i < m_cli->getTotalFEs(); i++) {
+            if(!m_cli->hasData(i))
+                continue;
             std::unique_ptr<std::vector<pixelHit>> data = m_cli->getData(i, true);
             if(data && data->size() > 0){
-                glm::vec3 chipScale = m_chips[i].scale;
-
-                Chip* currChip = &m_chips[i];
-                float hitSize = (1.0f / std::min(currChip->maxRows, currChip->maxCols)) * currChip->scale[0];
                 m_size += data->size();
                 nHits += data->size();
                 
-                for(int j = 0; j < data->size(); j++){
-                    std::uint16_t row = (*data)[j].row;
-                    std::uint16_t col = (*data)[j].col;
-
-                    if(row > m_chips[i].maxRows || col > m_chips[i].maxCols)
-                        break;
-                    
-                    float diffx = (2.0f * ((float)row / (float)currChip->maxRows) - 1.0f) * currChip->scale[0];
-                    float diffy = (2.0f * ((float)col / (float)currChip->maxCols) - 1.0f) * currChip->scale[1];
-                    glm::vec3 posRelToChip =  glm::vec3(diffx, diffy, 0.0f);
-                    glm::vec3 pos = currChip->pos + glm::toMat3(glm::quat(glm::vec3(viz_TO_RADIANS(currChip->eulerRot[0]), viz_TO_RADIANS(currChip->eulerRot[1]), viz_TO_RADIANS(currChip->eulerRot[2])))) * posRelToChip; //this could probably be optimized for later
-
-                    //CubeMesh.m_instances.emplace_back(defaultHitColor, transform(glm::vec3(hitSize, hitSize, currChip->scale[2] + 0.1f), currChip->eulerRot, pos));
-                    Particle tempPart;
-                    tempPart.pos = pos;
-                    tempPart.transform = transform(glm::vec3(hitSize, hitSize, currChip->scale[2] + 0.1f), currChip->eulerRot, pos);
-                    tempPart.color = glm::vec4(defaultHitColor, 1.0f);
-                    tempPart.is_immortal = false;
-                    tempPart.lifetime = particleLifetime;
-                    tempPart.ndcDepth = 0.0f;
-                    ParticlesContainer[FindUnusedParticle()] = tempPart;
-
-                    currChip->hits += 1;
-
-                    ParticleHit hitEvent(currChip->name, currChip->hits, row, col);
-                    eventCallback(hitEvent);
-                }
+                for(int j = 0; j < data->size(); j++)
+                    queueHit(i, (*data)[j].row, (*data)[j].col);
+                spawnHits(i);
 
                 data.reset();
                 m_nfe++;
             }
         }
-        //CubeMesh.updateInstances();
-        
-        CubeMesh.m_instances.clear();
-        for(int i = 0; i < ParticlesContainer.size(); i++){
-            Particle& p = ParticlesContainer[i];
-
-            if(!p.is_immortal){
-                if(p.lifetime > 0.0f);{
-                    p.lifetime -= dTime;
-                    if(p.lifetime > 0.0f){
-                        glm::vec4 clip = cam.getProj() * cam.getView() * glm::vec4(p.pos, 1.0f);
-                        float ndcDepth = clip.z / clip.w;
-                        p.ndcDepth = ndcDepth;
-
-                        InstanceData data;
-                        data.transform = p.transform;
-                        float ratio = p.lifetime / particleLifetime;
-                        data.color = glm::vec4((1 - ratio), ratio, 0, p.lifetime / particleLifetime);
-
-                        CubeMesh.m_instances.push_back(data);
-                    }
-                    else{
-                        p.ndcDepth = -1.0f;
-                    }
+
+        publishTally();
+        publishNewHits();
+    }
+
+    //Reconstructed mode: hits arrive grouped by bunch, and the bunches themselves are kept for eventWindow seconds
+    void Detector::ingestBunches(){
+        std::unique_ptr<std::vector<ReconstructedBunch>> bunches = m_cli->getReconstructedBunch();
+        if(!bunches)
+            return;
+
+        float now = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_startTime).count();
+        //one batch per chip over all bunches drained this time
+        for(int i = 0; i < m_chips.size(); i++){
+            for(const ReconstructedBunch& bunch : *bunches){
+                if(i >= bunch.totalFEs)
+                    continue;
+                const ::EventData& feData = bunch.peekEventDataFE(i);
+                for(const Event& event : feData.events){
+                    for(const Hit& hit : event.hits)
+                        queueHit(i, hit.row, hit.col);
                 }
-            }else{
-                glm::vec4 clip = cam.getProj() * cam.getView() * glm::vec4(p.pos, 1.0f);
-                float ndcDepth = clip.z / clip.w;
-                p.ndcDepth = ndcDepth;
-
-                InstanceData data;
-                data.transform = p.transform;
-                data.color = p.color;
-                CubeMesh.m_instances.push_back(data);
             }
+            spawnHits(i);
         }
-        std::cout << ParticlesContainer[900].lifetime << std::endl;
-        CubeMesh.updateInstances();
 
-        // m_cli->state = CLIstate::RECONSTRUCT;
-        // std::this_thread::sleep_for(std::chrono::nanoseconds(25));
-        // auto test = m_cli->getReconstructedBunch();
-        // for(int i = 0; i < test->size(); i++){
-        //     nHits += (*test)[i].nHits;
-        // }
-        // std::cout << "Detector hits total: " << nHits << std::endl;
+        for(ReconstructedBunch& bunch : *bunches){
+            m_size += bunch.nHits;
+            nHits += bunch.nHits;
+            if(eventBuffer.push(now, std::move(bunch)))
+                m_bunchesOverwritten++;
+        }
 
+        publishTally();
+        publishNewHits();
     }
 
-    void Detector::render(const Shader& shader){
-        glEnable(GL_BLEND);
-        glDepthMask(GL_FALSE);
-        CubeMesh.render(shader);
-        glDepthMask(GL_TRUE);
+    void Detector::queueHit(int chipId, std::uint16_t row, std::uint16_t col){
+        //YARR numbers pixels from 1; from here on they are 0-based, so they index the chip's pixel arrays directly
+        const Chip& chip = m_chips[chipId];
+        if(row == 0 || col == 0 || row > chip.maxRows || col > chip.maxCols){
+            m_hitsRejected++;
+            return;
+        }
+
+        m_queuedRows.push_back(row - 1);
+        m_queuedCols.push_back(col - 1);
     }
 
-    int Detector::FindUnusedParticle(){
-        for(int i=LastUsedParticle; i < 10000; i++){
-            if (ParticlesContainer[i].lifetime <= 0.0f && !ParticlesContainer[i].is_immortal){
-                    LastUsedParticle = i;
-                    return i;
+    void Detector::spawnHits(int chipId){
+        std::size_t n = m_queuedRows.size();
+        if(n == 0)
+            return;
+
+        m_occupancy.fill(chipId, m_queuedRows.data(), m_queuedCols.data(), n);
+        m_chipHits[chipId] += n;
+        m_tally.chipHits[chipId] += n;
+        m_tally.chipTotals[chipId] = m_chipHits[chipId];
+        for(std::size_t j = 0; j < n && m_tally.samples.size() < m_hitSamples; j++)
+            m_tally.samples.push_back({(std::uint16_t)chipId, m_queuedRows[j], m_queuedCols[j]});
+
+        float now = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_startTime).count();
+        for(std::size_t j = 0; j < n; j++){
+            if(m_decimation > 1 && m_decimationCount++ % m_decimation != 0){
+                m_hitsDecimated++;
+                continue;
             }
+
+            SlotHandle slot = allocateHit();
+            HitInstance hit(m_queuedRows[j], m_queuedCols[j], chipId, now);
+            *m_hits.get(slot) = hit;
+            m_hitOrder.push_back(slot);
+            m_newHits.slots.push_back(slot.index);
+            m_newHits.hits.push_back(hit);
+            m_liveParticles[chipId]++;
+        }
+
+        m_queuedRows.clear();
+        m_queuedCols.clear();
+    }
+
+    void Detector::publishTally(){
+        std::lock_guard<std::mutex> lock(m_tallyMutex);
+        for(std::size_t i = 0; i < m_tally.chipHits.size(); i++){
+            m_pendingTally.chipHits[i] += m_tally.chipHits[i];
+            m_tally.chipHits[i] = 0;
+        }
+        m_pendingTally.chipTotals = m_tally.chipTotals;
+        for(std::size_t i = 0; i < m_tally.samples.size() && m_pendingTally.samples.size() < m_hitSamples; i++)
+            m_pendingTally.samples.push_back(m_tally.samples[i]);
+        m_tally.samples.clear();
+    }
+
+    //Also after expiry without new hits, so the render thread stops drawing slots that emptied out
+    void Detector::publishNewHits(){
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        m_pendingHighWater = m_hits.highWater();
+        if(m_newHits.slots.empty())
+            return;
+
+        m_pendingUpload.slots.insert(m_pendingUpload.slots.end(), m_newHits.slots.begin(), m_newHits.slots.end());
+        m_pendingUpload.hits.insert(m_pendingUpload.hits.end(), m_newHits.hits.begin(), m_newHits.hits.end());
+        m_pendingUpload.capacity = m_hits.capacity();
+        m_newHits.clear();
+    }
+
+    //Hits expire in the order they were spawned and free slots are reused lowest first, so new
+    //hits mostly land in consecutive slots and go up in a few runs. A slot written twice keeps the later hit
+    void Detector::uploadNewHits(){
+        std::size_t highWater;
+        {
+            std::lock_guard<std::mutex> lock(m_uploadMutex);
+            std::swap(m_upload, m_pendingUpload);
+            highWater = m_pendingHighWater;
+        }
+        if(m_upload.slots.empty()){
+            m_hitMesh.setLiveSlots(highWater);
+            return;
+        }
+
+        m_hitMesh.reserveSlots(m_upload.capacity);
+        m_hitMesh.beginUpload();
+        std::size_t runStart = 0;
+        for(std::size_t i = 1; i <= m_upload.slots.size(); i++){
+            if(i < m_upload.slots.size() && m_upload.slots[i] == m_upload.slots[i - 1] + 1)
+                continue;
+            m_hitMesh.writeSlots(m_upload.slots[runStart], &m_upload.hits[runStart], i - runStart);
+            runStart = i;
+        }
+        m_hitMesh.setLiveSlots(highWater);
+        m_upload.clear();
+    }
+
+    SlotHandle Detector::allocateHit(){
+        SlotHandle slot = m_hits.allocate();
+        if(slot.isValid())
+            return slot;
+
+        SlotHandle oldest = m_hitOrder.front();
+        m_hitOrder.pop_front();
+        m_liveParticles[m_hits.get(oldest)->chip]--;
+        m_hits.free(oldest);
+        m_hitsDropped++;
+        return m_hits.allocate();
+    }
+
+    //All hits live equally long, so the expired ones are always at the front of the spawn order
+    void Detector::expireHits(float now){
+        while(!m_hitOrder.empty()){
+            const HitInstance* hit = m_hits.get(m_hitOrder.front());
+            if(hit->spawnTime + particleLifetime > now)
+                break;
+            m_liveParticles[hit->chip]--;
+            m_hits.free(m_hitOrder.front());
+            m_hitOrder.pop_front();
+        }
+    }
+
+    //Decimate: with hits arriving at rate r, keeping one in n leaves r * lifetime / n alive
+    void Detector::updateDecimation(float dTime){
+        if(m_overflow != OverflowPolicy::Decimate || m_hits.getMaxCapacity() == 0 || dTime <= 0.0f)
+            return;
+
+        m_hitRate += 0.1f * (m_size / dTime - m_hitRate);
+        float needed = std::ceil(m_hitRate * particleLifetime / m_hits.getMaxCapacity());
+        m_decimation = (std::uint32_t)std::max(1.0f, needed);
+    }
+
+    void Detector::buildSnapshot(float dTime){
+        float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_startTime).count();
+        eventBuffer.evictBefore(elapsed - m_eventWindow);
+        expireHits(elapsed);
+
+        DetectorSnapshot& snap = m_snapshots.back();
+        snap.instances.clear();
+        for(const Particle& p : m_chipParticles){
+            InstanceData data;
+            data.transform = p.transform;
+            data.color = p.color;
+            snap.instances.push_back(data);
         }
 
-        for(int i=0; i<LastUsedParticle; i++){
-            if (ParticlesContainer[i].lifetime <= 0.0f && !ParticlesContainer[i].is_immortal){
-                LastUsedParticle = i;
-                return i;
+        snap.chipHits = m_chipHits;
+        snap.liveParticles = m_liveParticles;
+        snap.newHits = m_size;
+        updateDecimation(dTime);
+        m_size = 0;
+        m_nfe = 0;
+        publishNewHits(); //for the high water mark after expiry
+        m_snapshots.publish();
+    }
+
+    //Heatmap mode: every chip in view; otherwise the tiles of the distant ones
+    void Detector::renderOpaque(const Shader& heatmapShader){
+        if(m_displayMode != DisplayMode::Heatmap && m_tileChips == 0)
+            return;
+
+        m_heatmapChips.resize(m_chips.size());
+        for(std::size_t i = 0; i < m_chips.size(); i++)
+            m_heatmapChips[i] = m_displayMode == DisplayMode::Heatmap ? m_chipLod[i] != ChipLod::Hidden : m_chipLod[i] == ChipLod::Tile;
+        m_occupancy.render(heatmapShader, m_heatmapChips);
+    }
+
+    //A chip's size on screen is estimated from its bounding sphere: diameter / distance, scaled by
+    //the projection's focal length to pixels. Only changes reach the GPU, through the chip table
+    //(the hit shader drops hits of chips not drawn Full) and the chip cubes.
+    void Detector::updateVisibility(const Camera& cam){
+        Frustum frustum = cam.getFrustum();
+        const CamData& view = cam.getCamData();
+        float pixelsPerRadian = 0.5f * view.screenSize.y * cam.getProj()[1][1];
+
+        bool changed = false;
+        m_tileChips = 0;
+        for(std::size_t i = 0; i < m_chips.size(); i++){
+            const Chip& chip = m_chips[i];
+            ChipLod lod = ChipLod::Hidden;
+            if(frustum.intersects(chip.boundsMin, chip.boundsMax)){
+                glm::vec3 center = 0.5f * (chip.boundsMin + chip.boundsMax);
+                float radius = 0.5f * glm::length(chip.boundsMax - chip.boundsMin);
+                float distance = glm::length(center - view.position);
+                bool small = m_lodPixels > 0.0f && distance > radius && 2.0f * radius / distance * pixelsPerRadian < m_lodPixels;
+                lod = small ? ChipLod::Tile : ChipLod::Full;
+            }
+
+            m_tileChips += lod == ChipLod::Tile;
+            if(lod != m_chipLod[i]){
+                m_chipLod[i] = lod;
+                changed = true;
             }
         }
 
-        for(int i = 0; i < 10000; i++){
-            if(!ParticlesContainer[i].is_immortal)
-                return i;
+        if(changed){
+            uploadChipTable();
+            m_chipsDirty = true;
         }
     }
 
-    void Detector::sortTransparent(const Camera& cam){
-        std::sort(ParticlesContainer.begin(), ParticlesContainer.end(), [](Particle& left, Particle& right){
-            return left.ndcDepth > right.ndcDepth;
-        });
+    void Detector::render(const Shader& shader, const Shader& hitShader, const Shader& pointShader){
+        CubeMesh.render(shader);
+        if(m_displayMode != DisplayMode::Hits)
+            return;
 
+        const Shader& active = m_drawPoints ? pointShader : hitShader;
+        active.use();
+        active.setFloat("uTime", std::chrono::duration<float>(std::chrono::steady_clock::now() - m_startTime).count());
+        active.setFloat("uLifetime", particleLifetime);
+        active.setVec4("uRampStart", hitColorNew);
+        active.setVec4("uRampEnd", hitColorOld);
+        if(m_drawPoints)
+            m_hitMesh.renderPoints(pointShader);
+        else
+            m_hitMesh.render(hitShader);
     }
 
-    // void Detector::sortTransparent(const Camera& cam){
-    //     std::vector<std::pair<unsigned int, float>> perm(m_chips.size());
-    //     for(int i = 0; i < m_chips.size(); i++){
-    //         glm::vec4 clip = cam.getProj() * cam.getView() * glm::vec4(m_chips[i].pos, 1.0f);
-    //         float ndcDepth = clip.z / clip.w;
-    //         perm[i] = std::make_pair(i, ndcDepth);
-    //     }
-    //     std::sort(perm.begin(), perm.end(), [](std::pair<unsigned int, float>& left, std::pair<unsigned int, float>& right){
-    //         return left.second > right.second;
-    //     });
-    //     std::vector<glm::mat4> secondMat = m_chipTransforms;
-    //     for(int i = 0; i < perm.size(); i++){
-    //         m_chipTransforms[i] = secondMat[perm[i].first];
-    //     }
-    //     std::vector<glm::vec4> secondVec = m_chipColors;
-    //     for(int i = 0; i < perm.size(); i++){
-    //         m_chipColors[i] = secondVec[perm[i].first];
-    //     }
-
-    //     ChipMesh.setInstances(m_chips.size(), m_chipTransforms, m_chipColors);
-    // }
+    std::vector<Chip> Detector::getChips() const{
+        std::vector<Chip> chips = m_chips;
+        const std::vector<std::uint64_t>& hits = m_snapshots.front().chipHits;
+        for(int i = 0; i < chips.size() && i < hits.size(); i++)
+            chips[i].hits = hits[i];
+        return chips;
+    }
 
     glm::mat4 Detector::transform(glm::vec3 scale, glm::vec3 eulerRot, glm::vec3 pos, bool isInRadians){
         glm::mat4 tempTfm = glm::mat4(1.0f);
@@ -264,4 +568,48 @@ namespace viz{
         tempTfm = glm::translate(glm::mat4(1.0f), pos) * tempTfm;
         return tempTfm;
     }
+
+    //Everything about a hit that only depends on its chip: the affine pixel map
+    //(the old per-hit pos + R * ((2 * row / maxRows - 1) * sx, (2 * col / maxCols - 1) * sy, 0)
+    //of the 1-based row and col; origin is one pixel in, as hits arrive here 0-based)
+    //and the rotation and scale of its cube, so a hit costs a few multiply-adds
+    void Detector::computeChipTransform(Chip& chip){
+        glm::mat3 rot = glm::toMat3(glm::quat(glm::vec3(viz_TO_RADIANS(chip.eulerRot[0]), viz_TO_RADIANS(chip.eulerRot[1]), viz_TO_RADIANS(chip.eulerRot[2]))));
+        glm::vec3 rowStep = rot * glm::vec3(2.0f * chip.scale[0] / chip.maxRows, 0.0f, 0.0f);
+        glm::vec3 colStep = rot * glm::vec3(0.0f, 2.0f * chip.scale[1] / chip.maxCols, 0.0f);
+        glm::vec3 origin = chip.pos - rot * glm::vec3(chip.scale[0], chip.scale[1], 0.0f) + rowStep + colStep;
+        for(int k = 0; k < 3; k++){
+            chip.pixelMap.origin[k] = origin[k];
+            chip.pixelMap.rowStep[k] = rowStep[k];
+            chip.pixelMap.colStep[k] = colStep[k];
+        }
+
+        float hitSize = (1.0f / std::min(chip.maxRows, chip.maxCols)) * chip.scale[0];
+        chip.hitBasis = rot * glm::mat3(glm::vec3(hitSize, 0.0f, 0.0f), glm::vec3(0.0f, hitSize, 0.0f), glm::vec3(0.0f, 0.0f, chip.scale[2] + 0.1f));
+
+        //box of the chip and of hit cubes on its edges, rotated: the half extents along each world
+        //axis are the absolute rotation times the local ones
+        glm::vec3 halfSize(chip.scale[0] + hitSize, chip.scale[1] + hitSize, chip.scale[2] + 0.1f);
+        glm::mat3 absRot;
+        for(int c = 0; c < 3; c++)
+            absRot[c] = glm::abs(rot[c]);
+        glm::vec3 extent = absRot * halfSize;
+        chip.boundsMin = chip.pos - extent;
+        chip.boundsMax = chip.pos + extent;
+    }
+
+    //The hit shader's copy of computeChipTransform's results and of m_chipLod; call after either changes, on the render thread
+    void Detector::uploadChipTable(){
+        std::vector<ChipTableEntry> table(m_chips.size());
+        for(int i = 0; i < m_chips.size(); i++){
+            const Chip& chip = m_chips[i];
+            float drawHits = m_chipLod[i] == ChipLod::Full ? 1.0f : 0.0f;
+            table[i].origin = glm::vec4(chip.pixelMap.origin[0], chip.pixelMap.origin[1], chip.pixelMap.origin[2], drawHits);
+            table[i].rowStep = glm::vec4(chip.pixelMap.rowStep[0], chip.pixelMap.rowStep[1], chip.pixelMap.rowStep[2], 0.0f);
+            table[i].colStep = glm::vec4(chip.pixelMap.colStep[0], chip.pixelMap.colStep[1], chip.pixelMap.colStep[2], 0.0f);
+            for(int k = 0; k < 3; k++)
+                table[i].basis[k] = glm::vec4(chip.hitBasis[k], 0.0f);
+        }
+        m_hitMesh.setChipTable(table);
+    }
 }
\ No newline at end of file
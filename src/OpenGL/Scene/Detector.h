@@ -4,6 +4,7 @@
 
 #include "core/header.h"
 #include "OpenGL/Scene/Mesh.h"
+#include "OpenGL/Scene/Occupancy.h"
 
 #include "Events/ParticleEvent.h"
 #include "OpenGL/Camera.h"
@@ -14,8 +15,16 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "cli.h"
+#include "mathtools.h"
 
 #include "CircularBuffer.h"
+#include "SlotAllocator.h"
+#include "TripleBuffer.h"
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 namespace viz{
     extern std::vector<SimpleVertex> CubeVertices;
@@ -29,6 +38,11 @@ namespace viz{
 
         glm::vec3 pos, eulerRot;
         glm::vec3 scale;
+
+        //Derived from the geometry above by Detector::computeChipTransform
+        PixelTransform pixelMap; //(row, col) to the world position of the hit
+        glm::mat3 hitBasis;      //rotation and size of a hit cube, the upper 3x3 of its model matrix
+        glm::vec3 boundsMin, boundsMax; //world space box around the chip and its hits
     };
 
     struct Particle{
@@ -37,7 +51,51 @@ namespace viz{
         glm::vec4 color;
 
         bool is_immortal;
-        float lifetime, ndcDepth;
+        float lifetime;
+        int chipId = -1;
+    };
+
+    //Hits counted by the processing thread since the render thread last took them, which
+    //become the frame's HitSummary
+    struct HitTally{
+        std::vector<std::uint32_t> chipHits;
+        std::vector<std::uint64_t> chipTotals;
+        std::vector<HitSummary::Sample> samples;
+    };
+
+    //Hits spawned by the processing thread, by slot of Detector::m_hits, which is also their slot on the GPU
+    struct HitUpload{
+        std::vector<std::uint32_t> slots;
+        std::vector<HitInstance> hits;
+        std::size_t capacity = 0; //slots in the pool when these were spawned
+
+        void clear() { slots.clear(); hits.clear(); }
+    };
+
+    //GPU-ready state produced by the processing thread; the render thread only uploads it
+    struct DetectorSnapshot{
+        std::vector<InstanceData> instances; //chips
+        std::vector<std::uint64_t> chipHits;
+        std::vector<std::size_t> liveParticles;
+        std::uint32_t newHits = 0; //hits ingested since the previous snapshot
+    };
+
+    //What happens to new hits once the instance budget is used up
+    enum class OverflowPolicy{
+        DropOldest, //every new hit is drawn, the oldest ones make room
+        Decimate    //only every n-th new hit is drawn, n chosen so the hits of one lifetime fit the budget
+    };
+
+    enum class DisplayMode{
+        Hits,   //every live hit as a cube
+        Heatmap //accumulated hit count per pixel on each chip (OccupancyMap)
+    };
+
+    //How much of a chip is drawn, decided per frame from the camera
+    enum class ChipLod : std::uint8_t{
+        Hidden, //outside the view frustum: neither the chip nor its hits
+        Full,   //the chip and every hit
+        Tile    //smaller on screen than lod_pixels: the chip and its heatmap instead of the hits
     };
 
     class Detector{
@@ -45,24 +103,47 @@ namespace viz{
             bool startCLI = false;
 
             Detector();
+            ~Detector();
 
             void init(const std::shared_ptr<VisualizerCli>& cli);
 
+            //Render thread: picks up the latest snapshot, uploads it and sends the frame's HitSummary
             void update(const Camera& cam, float dTime);
             void setEventCallback(const std::function<void(event& e)>& callback) { eventCallback = callback; }
 
-            void render(const Shader& shader);
-            void sortTransparent(const Camera& cam);
-            std::vector<Chip> getChips() const { return m_chips;}
+            //Draws what is opaque (the heatmaps) with depth writes, before the translucent pass
+            void renderOpaque(const Shader& heatmapShader);
+            //Draws chips and hits with the blending and depth state set by the caller; all of them are translucent
+            //Hits are cubes (hitShader) or, with many of them alive, points (pointShader)
+            void render(const Shader& shader, const Shader& hitShader, const Shader& pointShader);
+            void setDisplayMode(DisplayMode mode) { m_displayMode = mode; }
+            DisplayMode getDisplayMode() const { return m_displayMode; }
+            std::vector<Chip> getChips() const;
+            MemoryStats getMemoryStats(int fe_id) const { return m_cli->getMemoryStats(fe_id); }
 
             uint32_t totHits();
 
             float particleLifetime = 10;
         private:
-            int FindUnusedParticle();
-            int LastUsedParticle = 0;
+            //Processing thread: ingests hits, ages particles and publishes snapshots
+            void processLoop();
+            void ingestHits();
+            void ingestBunches();
+            //Queues a hit (1-based, as YARR sends them) for spawnHits as 0-based; hits outside the chip are counted and skipped
+            void queueHit(int chipId, std::uint16_t row, std::uint16_t col);
+            void spawnHits(int chipId); //spawns the queued hits of chipId in one batch
+            void publishTally();        //adds m_tally to what the render thread picks up next
+            void buildSnapshot(float dTime);
+            void publishNewHits();      //hands m_newHits to the render thread
+            void uploadNewHits();       //render thread: writes the published hits into their GPU slots
+            void expireHits(float now); //frees every hit older than particleLifetime
+            SlotHandle allocateHit();   //gives up the oldest hit if the pool is at its limit
+            void updateDecimation(float dTime);
 
             glm::mat4 transform(glm::vec3 scale, glm::vec3 eulerRot, glm::vec3 pos, bool isInRadians = false);
+            void computeChipTransform(Chip& chip); //call whenever the chip geometry changes
+            void uploadChipTable();
+            void updateVisibility(const Camera& cam); //render thread, sets m_chipLod
             std::shared_ptr<VisualizerCli> m_cli;
 
             GLuint m_instBufID; 
@@ -72,18 +153,73 @@ namespace viz{
             std::uint32_t nHits = 0;
 
             //CLI state is RECONSTRUCTED
-            //CircularBuffer<ReconstructedBunch> circularEventBuffer; //Moving window of reconstructed events are displayed at a time
-            std::vector<ReconstructedBunch> eventBuffer; //Indefinite number of reconstructed events displayed
+            //Moving window of reconstructed bunches keyed by arrival time (seconds since init); processing thread only
+            CircularBuffer<ReconstructedBunch, float> eventBuffer{4096};
+            bool m_reconstruct = false;
+            float m_eventWindow = 10.0f;
+            std::uint64_t m_bunchesOverwritten = 0; //bunches lost because the buffer filled before the window passed
+            std::chrono::steady_clock::time_point m_startTime;
             
             glm::mat4 m_transform;
             std::vector<Chip> m_chips;
-            std::vector<Particle> ParticlesContainer;
+            std::vector<Particle> m_chipParticles; //immortal, one per chip
+            SlotAllocator<HitInstance> m_hits{10000};
+            std::deque<SlotHandle> m_hitOrder;     //live hits in spawn order, which is also their expiry order
+            std::uint64_t m_hitsDropped = 0;       //hits given up before their time because the pool was full
+            std::uint64_t m_hitsRejected = 0;      //hits with a pixel outside their chip
+
+            OverflowPolicy m_overflow = OverflowPolicy::DropOldest;
+            std::uint32_t m_decimation = 1;        //Decimate: draw one in this many new hits
+            std::uint64_t m_decimationCount = 0;
+            std::uint64_t m_hitsDecimated = 0;
+            float m_hitRate = 0.0f;                //hits per second, smoothed over snapshots
+            std::vector<std::size_t> m_liveParticles; //per chip, reported to the CLI memory accounting
+            std::vector<std::uint64_t> m_chipHits;     //processing thread copy of Chip::hits
+
+            //Hits of one chip waiting for spawnHits; processing thread only
+            std::vector<std::uint16_t> m_queuedRows, m_queuedCols;
+
+            std::thread m_procThread;
+            std::atomic<bool> m_procRun{false};
+            std::chrono::microseconds m_snapshotInterval{10000};
+            TripleBuffer<DetectorSnapshot> m_snapshots;
+
+            HitTally m_tally;          //processing thread
+            std::mutex m_tallyMutex;
+            HitTally m_pendingTally;   //guarded by m_tallyMutex
+            HitSummary m_summary;      //render thread, sent once per frame with hits
+            std::size_t m_hitSamples = 4;
+
+            //Only new hits travel to the GPU; aging and expiry happen in the hit shader
+            HitUpload m_newHits;       //processing thread
+            std::mutex m_uploadMutex;
+            HitUpload m_pendingUpload; //guarded by m_uploadMutex
+            HitUpload m_upload;        //render thread
+            std::size_t m_pendingHighWater = 0; //one past the highest live slot, guarded by m_uploadMutex
 
             SimpleMesh CubeMesh;
+            HitMesh m_hitMesh;
+            OccupancyMap m_occupancy; //counts every hit, whatever the display mode
+            DisplayMode m_displayMode = DisplayMode::Hits;
+
+            //Render thread: what each chip draws this frame, and the chip cubes it is taken from
+            std::vector<ChipLod> m_chipLod;
+            std::vector<InstanceData> m_chipInstances; //all chips, from the latest snapshot
+            std::vector<bool> m_heatmapChips;          //chips OccupancyMap draws
+            std::size_t m_tileChips = 0;
+            bool m_chipsDirty = false;                 //CubeMesh has to be rebuilt from m_chipInstances
+            float m_lodPixels = 48.0f;                 //0: always Full
+
+            //Hits are drawn as points once more than m_pointThreshold are alive (0: never), and as
+            //cubes again below 90 % of it, so the mode does not flicker around the threshold
+            std::size_t m_pointThreshold = 200000;
+            std::size_t m_liveHits = 0; //as of the latest snapshot
+            bool m_drawPoints = false;
             std::size_t startOfHitBuffer = 0;
 
             glm::vec3 hitScale = glm::vec3(0.05f, 0.05f, 0.05f);
-            glm::vec3 defaultHitColor = glm::vec4(1.0f, 0.2509f, 0.0235f, 1.0f);
+            glm::vec4 hitColorNew = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f); //colour ramp over the lifetime of a hit, applied by the hit shader
+            glm::vec4 hitColorOld = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
 
             std::function<void(event& e)> eventCallback;
 
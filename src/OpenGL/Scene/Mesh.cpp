@@ -1,25 +1,62 @@
 #include "OpenGL/Scene/Mesh.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
 namespace viz{
+    //Positions of the hits in slots [uFirst, uFirst + uCount), see HitMesh. The buffer layouts
+    //are those of HitInstance and ChipTableEntry; precise keeps the compiler from fusing the
+    //multiply-adds, so the result matches transformPixels
+    static const char* hitTransformShaderSource="#version 430 core\n"
+        "layout (local_size_x = 64) in;\n"
+
+        "struct Hit { uint rowCol; uint chip; float spawnTime; float pad; };\n"
+        "struct Chip { vec4 origin; vec4 rowStep; vec4 colStep; vec4 basis[3]; };\n"
+
+        "layout (std430, binding = 0) readonly buffer Hits { Hit hits[]; };\n"
+        "layout (std430, binding = 1) readonly buffer Chips { Chip chips[]; };\n"
+        "layout (std430, binding = 2) writeonly buffer Positions { vec4 positions[]; };\n"
+
+        "uniform uint uFirst;\n"
+        "uniform uint uCount;\n"
+
+        "void main()\n"
+        "{\n"
+        "   if(gl_GlobalInvocationID.x >= uCount)\n"
+        "       return;\n"
+        "   uint slot = uFirst + gl_GlobalInvocationID.x;\n"
+        "   Hit hit = hits[slot];\n"
+        "   Chip chip = chips[hit.chip];\n"
+        "   precise vec3 world = (chip.origin.xyz + float(hit.rowCol & 0xFFFFu) * chip.rowStep.xyz) + float(hit.rowCol >> 16) * chip.colStep.xyz;\n"
+        "   positions[slot] = vec4(world, 1.0);\n"
+        "}\0";
+
+    //Draws count instances from first on in chunks of at most maxInstancesPerDraw. With GL 4.2
+    //a chunk starts at its base instance; otherwise rebind(first) re-points the instance
+    //attributes at it, which also binds the VAO again
+    template <typename Rebind>
+    static void drawInstancedChunks(GLsizei indices, std::size_t first, std::size_t count, Rebind rebind){
+        for(std::size_t done = 0; done < count; done += maxInstancesPerDraw){
+            GLsizei n = static_cast<GLsizei>(std::min(maxInstancesPerDraw, count - done));
+            if(GLAD_GL_VERSION_4_2){
+                glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indices, GL_UNSIGNED_INT, (GLvoid*)0, n, static_cast<GLuint>(first + done));
+            }else{
+                if(first + done != 0)
+                    rebind(first + done);
+                glDrawElementsInstanced(GL_TRIANGLES, indices, GL_UNSIGNED_INT, (GLvoid*)0, n);
+            }
+        }
+        if(!GLAD_GL_VERSION_4_2 && first + count > maxInstancesPerDraw)
+            rebind(0);
+    }
+
     void SimpleMesh::init(){
         glGenVertexArrays(1, &m_VAO);
         glBindVertexArray(m_VAO);
         
-        std::size_t vec4Size = sizeof(glm::vec4);
-
         glGenBuffers(1, &m_instancesVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, m_instancesVBO);
-
-        glEnableVertexAttribArray(2); //color
-        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)0);
-        glEnableVertexAttribArray(3); //transform matrix
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)vec4Size);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(2*vec4Size));
-        glEnableVertexAttribArray(5);   
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(3*vec4Size));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(4*vec4Size));
+        bindInstanceAttributes(m_instancesVBO);
 
         glVertexAttribDivisor(2, 1); //color
         glVertexAttribDivisor(3, 1); //transform matrix
@@ -48,6 +85,63 @@ namespace viz{
         m_isInit = true;
     }
 
+    //Points the instance attributes of the VAO at buffer, starting from instance firstInstance.
+    //Leaves the VAO bound
+    void SimpleMesh::bindInstanceAttributes(GLuint buffer, std::size_t firstInstance) const {
+        std::size_t vec4Size = sizeof(glm::vec4);
+        std::size_t base = firstInstance * sizeof(InstanceData);
+
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+        glEnableVertexAttribArray(2); //color
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)base);
+        glEnableVertexAttribArray(3); //transform matrix
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + vec4Size));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + 2*vec4Size));
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + 3*vec4Size));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + 4*vec4Size));
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    bool SimpleMesh::setStreaming(bool streaming){
+        if(streaming == isStreaming())
+            return true;
+        if(!streaming){
+            m_stream.release();
+            m_streamBound = 0;
+            m_baseInstance = 0;
+            bindInstanceAttributes(m_instancesVBO);
+            glBindVertexArray(0);
+            updateInstances();
+            return true;
+        }
+        if(!StreamBuffer::isSupported())
+            return false;
+
+        m_stream.init(std::max<std::size_t>(m_instances.size(), 64) * sizeof(InstanceData));
+        updateInstances();
+        return true;
+    }
+
+    InstanceData* SimpleMesh::mapInstances(std::size_t n){
+        std::size_t offset;
+        m_stream.advance();
+        InstanceData* mapped = static_cast<InstanceData*>(m_stream.allocate(n * sizeof(InstanceData), offset));
+        if(m_stream.getID() != m_streamBound){
+            bindInstanceAttributes(m_stream.getID());
+            glBindVertexArray(0);
+            m_streamBound = m_stream.getID();
+        }
+        m_baseInstance = offset / sizeof(InstanceData);
+        m_instancesToRender = n;
+        return mapped;
+    }
+
     SimpleMesh::SimpleMesh(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices, bool isInstancedRendered){
         m_vertices = vertices;
         m_indices = indices;
@@ -56,6 +150,33 @@ namespace viz{
         init();
     }
 
+    SimpleMesh::~SimpleMesh(){
+        m_stream.release();
+        if(!m_isInit)
+            return;
+        glDeleteBuffers(1, &m_VBO);
+        glDeleteBuffers(1, &m_EBO);
+        glDeleteBuffers(1, &m_instancesVBO);
+        glDeleteVertexArrays(1, &m_VAO);
+    }
+
+    void SimpleMesh::swap(SimpleMesh& other) noexcept {
+        using std::swap;
+        swap(m_instances, other.m_instances);
+        swap(m_isInit, other.m_isInit);
+        swap(m_isInstancedRendered, other.m_isInstancedRendered);
+        swap(m_instancesToRender, other.m_instancesToRender);
+        swap(m_vertices, other.m_vertices);
+        swap(m_indices, other.m_indices);
+        swap(m_VAO, other.m_VAO);
+        swap(m_VBO, other.m_VBO);
+        swap(m_EBO, other.m_EBO);
+        swap(m_instancesVBO, other.m_instancesVBO);
+        swap(m_stream, other.m_stream);
+        swap(m_streamBound, other.m_streamBound);
+        swap(m_baseInstance, other.m_baseInstance);
+    }
+
     void SimpleMesh::setData(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices, bool isInstancedRendered){
         m_vertices = vertices;
         m_indices = indices;
@@ -79,7 +200,7 @@ namespace viz{
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);   
     }
 
-    void SimpleMesh::allocateInstances(std::uint16_t instances){
+    void SimpleMesh::allocateInstances(std::size_t instances){
         glBindVertexArray(m_VAO);
         glBindBuffer(GL_ARRAY_BUFFER, m_instancesVBO);
         glBufferData(GL_ARRAY_BUFFER, instances * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
@@ -96,12 +217,16 @@ namespace viz{
     }
 
     void SimpleMesh::updateInstances(){
+        if(isStreaming()){
+            std::copy(m_instances.begin(), m_instances.end(), mapInstances(m_instances.size()));
+            return;
+        }
         m_instancesToRender = m_instances.size();
 
         glBindVertexArray(m_VAO);
         glBindBuffer(GL_ARRAY_BUFFER, m_instancesVBO);
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLuint>(m_instancesToRender * sizeof(InstanceData)), NULL, GL_STREAM_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLuint>(m_instancesToRender * sizeof(InstanceData)), m_instances.data());
+        glBufferData(GL_ARRAY_BUFFER, m_instancesToRender * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_instancesToRender * sizeof(InstanceData), m_instances.data());
 
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -115,9 +240,321 @@ namespace viz{
             glDrawElements(GL_TRIANGLES, static_cast<GLuint>(m_indices.size()), GL_UNSIGNED_INT, (GLvoid*)0);
         }else{
             shader.setBool("uIsInstanced", true);
-            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLuint>(m_indices.size()), GL_UNSIGNED_INT, (GLvoid*)0, m_instancesToRender);
+            GLuint buffer = isStreaming() ? m_stream.getID() : m_instancesVBO;
+            drawInstancedChunks(static_cast<GLsizei>(m_indices.size()), m_baseInstance, m_instancesToRender, [&](std::size_t first){
+                bindInstanceAttributes(buffer, first);
+            });
         }
         glBindVertexArray(0);
         return;
     }
+
+    HitMesh::HitMesh(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices){
+        m_vertices = vertices;
+        m_indices = indices;
+
+        glGenVertexArrays(1, &m_VAO);
+        glBindVertexArray(m_VAO);
+
+        glGenBuffers(1, &m_instancesVBO);
+        glGenBuffers(1, &m_positionsVBO);
+        bindInstanceAttributes(m_instancesVBO);
+        glVertexAttribDivisor(2, 1);
+        glVertexAttribDivisor(3, 1);
+        glVertexAttribDivisor(4, 1);
+
+        glGenBuffers(1, &m_VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(SimpleVertex), &m_vertices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SimpleVertex), (void*)0);
+
+        glGenBuffers(1, &m_EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), &m_indices[0], GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        glGenBuffers(1, &m_chipBuffer);
+        glGenTextures(1, &m_chipTexture);
+
+        glGenVertexArrays(1, &m_pointVAO);
+        bindPointAttributes();
+    }
+
+    HitMesh::~HitMesh(){
+        m_stream.release();
+        if(m_VAO == 0)
+            return;
+        GLuint buffers[] = {m_VBO, m_EBO, m_instancesVBO, m_positionsVBO, m_chipBuffer};
+        glDeleteBuffers(5, buffers);
+        glDeleteTextures(1, &m_chipTexture);
+        glDeleteVertexArrays(1, &m_VAO);
+        glDeleteVertexArrays(1, &m_pointVAO);
+    }
+
+    void HitMesh::swap(HitMesh& other) noexcept {
+        using std::swap;
+        swap(m_vertices, other.m_vertices);
+        swap(m_indices, other.m_indices);
+        swap(m_slots, other.m_slots);
+        swap(m_liveSlots, other.m_liveSlots);
+        swap(m_VAO, other.m_VAO);
+        swap(m_VBO, other.m_VBO);
+        swap(m_EBO, other.m_EBO);
+        swap(m_pointVAO, other.m_pointVAO);
+        swap(m_instancesVBO, other.m_instancesVBO);
+        swap(m_positionsVBO, other.m_positionsVBO);
+        swap(m_chipBuffer, other.m_chipBuffer);
+        swap(m_chipTexture, other.m_chipTexture);
+        swap(m_stream, other.m_stream);
+        swap(m_transform, other.m_transform);
+        swap(m_verifyPending, other.m_verifyPending);
+        swap(m_pixelMaps, other.m_pixelMaps);
+        swap(m_rows, other.m_rows);
+        swap(m_cols, other.m_cols);
+        swap(m_x, other.m_x);
+        swap(m_y, other.m_y);
+        swap(m_z, other.m_z);
+        swap(m_positions, other.m_positions);
+    }
+
+    void HitMesh::setChipTable(const std::vector<ChipTableEntry>& chips){
+        glBindBuffer(GL_TEXTURE_BUFFER, m_chipBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, chips.size() * sizeof(ChipTableEntry), chips.data(), GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, m_chipTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_chipBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        m_pixelMaps.resize(chips.size());
+        for(std::size_t i = 0; i < chips.size(); i++){
+            for(int k = 0; k < 3; k++){
+                m_pixelMaps[i].origin[k] = chips[i].origin[k];
+                m_pixelMaps[i].rowStep[k] = chips[i].rowStep[k];
+                m_pixelMaps[i].colStep[k] = chips[i].colStep[k];
+            }
+        }
+    }
+
+    bool HitMesh::setCompute(bool compute){
+        if(!compute){
+            m_transform.reset();
+            return true;
+        }
+        if(!GLAD_GL_VERSION_4_3)
+            return false;
+        if(!m_transform)
+            m_transform = std::make_unique<Shader>("hitTransform", hitTransformShaderSource);
+        return true;
+    }
+
+    void HitMesh::reserveSlots(std::size_t slots){
+        if(slots <= m_slots)
+            return;
+
+        //positions first, bindInstanceAttributes below points at the new buffer
+        GLuint positions;
+        glGenBuffers(1, &positions);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positions);
+        glBufferData(GL_COPY_WRITE_BUFFER, slots * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+        if(m_slots > 0){
+            glBindBuffer(GL_COPY_READ_BUFFER, m_positionsVBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_slots * sizeof(glm::vec4));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &m_positionsVBO);
+        m_positionsVBO = positions;
+
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, slots * sizeof(HitInstance), NULL, GL_DYNAMIC_DRAW);
+        if(m_slots > 0){
+            glBindBuffer(GL_COPY_READ_BUFFER, m_instancesVBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_slots * sizeof(HitInstance));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        std::vector<HitInstance> dead(slots - m_slots, HitInstance::dead());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, m_slots * sizeof(HitInstance), dead.size() * sizeof(HitInstance), dead.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        bindInstanceAttributes(buffer);
+        glBindVertexArray(0);
+
+        glDeleteBuffers(1, &m_instancesVBO);
+        m_instancesVBO = buffer;
+        m_slots = slots;
+        bindPointAttributes();
+    }
+
+    //As SimpleMesh::bindInstanceAttributes
+    void HitMesh::bindInstanceAttributes(GLuint buffer, std::size_t firstInstance) const {
+        std::size_t base = firstInstance * sizeof(HitInstance);
+
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glEnableVertexAttribArray(2); //row | col << 16, chip
+        glVertexAttribIPointer(2, 2, GL_UNSIGNED_INT, sizeof(HitInstance), (void*)base);
+        glEnableVertexAttribArray(3); //spawn time
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(HitInstance), (void*)(base + offsetof(HitInstance, spawnTime)));
+        glBindBuffer(GL_ARRAY_BUFFER, m_positionsVBO);
+        glEnableVertexAttribArray(4); //world position
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(firstInstance * sizeof(glm::vec4)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void HitMesh::bindPointAttributes() const {
+        glBindVertexArray(m_pointVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_instancesVBO);
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 2, GL_UNSIGNED_INT, sizeof(HitInstance), (void*)0);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(HitInstance), (void*)offsetof(HitInstance, spawnTime));
+        glBindBuffer(GL_ARRAY_BUFFER, m_positionsVBO);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    bool HitMesh::setStreaming(bool streaming){
+        if(!streaming){
+            m_stream.release();
+            return true;
+        }
+        if(!StreamBuffer::isSupported())
+            return false;
+        if(!m_stream.isInit())
+            m_stream.init(4096 * sizeof(HitInstance));
+        return true;
+    }
+
+    void HitMesh::beginUpload(){
+        if(m_stream.isInit())
+            m_stream.advance();
+    }
+
+    void HitMesh::writeSlots(std::size_t first, const HitInstance* hits, std::size_t n){
+        if(first + n > m_slots)
+            reserveSlots(first + n);
+
+        if(m_stream.isInit()){
+            std::size_t offset;
+            std::copy(hits, hits + n, static_cast<HitInstance*>(m_stream.allocate(n * sizeof(HitInstance), offset)));
+            glBindBuffer(GL_COPY_READ_BUFFER, m_stream.getID());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_instancesVBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, first * sizeof(HitInstance), n * sizeof(HitInstance));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        else{
+            glBindBuffer(GL_ARRAY_BUFFER, m_instancesVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(HitInstance), n * sizeof(HitInstance), hits);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        if(!m_transform){
+            transformOnCpu(hits, n);
+            glBindBuffer(GL_ARRAY_BUFFER, m_positionsVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), n * sizeof(glm::vec4), m_positions.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return;
+        }
+
+        transformSlots(first, n);
+        if(m_verifyPending){
+            m_verifyPending = false;
+            transformOnCpu(hits, n);
+            std::vector<glm::vec4> gpu(n);
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_COPY_READ_BUFFER, m_positionsVBO);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, first * sizeof(glm::vec4), n * sizeof(glm::vec4), gpu.data());
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+            std::size_t mismatches = 0;
+            for(std::size_t i = 0; i < n; i++)
+                mismatches += std::memcmp(&gpu[i], &m_positions[i], sizeof(glm::vec4)) != 0;
+            if(mismatches == 0)
+                m_appLogger->info("Hit transform: compute shader and CPU agree on {} hits", n);
+            else
+                m_appLogger->error("Hit transform: compute shader and CPU differ on {} of {} hits", mismatches, n);
+        }
+    }
+
+    void HitMesh::transformSlots(std::size_t first, std::size_t n){
+        m_transform->use();
+        m_transform->setUInt("uFirst", static_cast<GLuint>(first));
+        m_transform->setUInt("uCount", static_cast<GLuint>(n));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instancesVBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_chipBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_positionsVBO);
+        glDispatchCompute(static_cast<GLuint>((n + 63) / 64), 1, 1);
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        for(GLuint binding = 0; binding < 3; binding++)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+
+    //Hits arrive in runs of one chip (Detector spawns them chip by chip), so each run goes
+    //through transformPixels in one call
+    void HitMesh::transformOnCpu(const HitInstance* hits, std::size_t n){
+        m_rows.resize(n);
+        m_cols.resize(n);
+        m_x.resize(n);
+        m_y.resize(n);
+        m_z.resize(n);
+        for(std::size_t i = 0; i < n; i++){
+            m_rows[i] = hits[i].row();
+            m_cols[i] = hits[i].col();
+        }
+
+        for(std::size_t begin = 0, end; begin < n; begin = end){
+            std::uint32_t chip = hits[begin].chip;
+            for(end = begin + 1; end < n && hits[end].chip == chip; end++);
+            if(chip >= m_pixelMaps.size())
+                continue; //dead slot
+            transformPixels(m_pixelMaps[chip], &m_rows[begin], &m_cols[begin], end - begin, &m_x[begin], &m_y[begin], &m_z[begin]);
+        }
+
+        m_positions.resize(n);
+        for(std::size_t i = 0; i < n; i++)
+            m_positions[i] = glm::vec4(m_x[i], m_y[i], m_z[i], 1.0f);
+    }
+
+    void HitMesh::render(const Shader& shader) const {
+        if(m_liveSlots == 0)
+            return;
+
+        shader.use();
+        glActiveTexture(GL_TEXTURE0 + chipTableUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, m_chipTexture);
+        shader.setInt("uChips", chipTableUnit);
+
+        glBindVertexArray(m_VAO);
+        drawInstancedChunks(static_cast<GLsizei>(m_indices.size()), 0, m_liveSlots, [&](std::size_t first){
+            bindInstanceAttributes(m_instancesVBO, first);
+        });
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void HitMesh::renderPoints(const Shader& shader) const {
+        if(m_liveSlots == 0)
+            return;
+
+        shader.use();
+        glActiveTexture(GL_TEXTURE0 + chipTableUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, m_chipTexture);
+        shader.setInt("uChips", chipTableUnit);
+
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBindVertexArray(m_pointVAO);
+        for(std::size_t first = 0; first < m_liveSlots; first += maxInstancesPerDraw)
+            glDrawArrays(GL_POINTS, static_cast<GLint>(first), static_cast<GLsizei>(std::min(maxInstancesPerDraw, m_liveSlots - first)));
+        glBindVertexArray(0);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
 }
\ No newline at end of file
@@ -3,16 +3,49 @@
 
 #include "core/header.h"
 #include "OpenGL/Shader.h"
+#include "OpenGL/StreamBuffer.h"
+#include "mathtools.h"
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <memory>
 //TODO: Abstract away SimpleMesh and NormalMesh to general Mesh class.
 //TODO: Allocate a maximum instances count; use glSubBufferData rather than glBufferData in SimpleMesh (this should optimize rendering)
 
 namespace viz{
+    //Instanced draws are split into draws of at most this many instances
+    constexpr std::size_t maxInstancesPerDraw = 1 << 20;
+
     struct InstanceData{
         glm::vec4 color;
         glm::mat4 transform;
     };
 
+    //One hit as the GPU sees it; the vertex shader turns it into a model matrix and colour
+    //with the chip table (ChipTableEntry) and the time uniforms
+    struct HitInstance{
+        std::uint32_t rowCol;   //row | col << 16
+        std::uint32_t chip;     //index into the chip table
+        float spawnTime;        //seconds since Detector::init
+        float pad = 0.0f;       //keeps arrays of hits 16 byte aligned
+
+        //Never drawn: the shader treats it as long expired
+        static HitInstance dead() { HitInstance hit(0, 0, 0, -1e30f); return hit; }
+
+        HitInstance() = default;
+        HitInstance(std::uint16_t row, std::uint16_t col, std::uint32_t chipId, float time) : rowCol(row | ((std::uint32_t)col << 16)), chip(chipId), spawnTime(time) {}
+
+        std::uint16_t row() const { return rowCol & 0xFFFF; }
+        std::uint16_t col() const { return rowCol >> 16; }
+    };
+
+    //Per chip constants of the hit shader, one texel per vec4 of a texture buffer:
+    //world = origin + row * rowStep + col * colStep, and the hit cube is basis * vertex + world.
+    //origin.w is 1 while the chip's hits are drawn, 0 to drop them (culled or drawn as a tile)
+    struct ChipTableEntry{
+        glm::vec4 origin, rowStep, colStep;
+        glm::vec4 basis[3];
+    };
+
     struct SimpleVertex{
         glm::vec3 pos;
         glm::vec4 color;
@@ -31,32 +64,127 @@ namespace viz{
         public:
             SimpleMesh() = default;
             SimpleMesh(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices, bool isInstancedRendered);
+            ~SimpleMesh(); //deletes the GL objects, so meshes are moved, never copied
+
+            SimpleMesh(const SimpleMesh&) = delete;
+            SimpleMesh& operator=(const SimpleMesh&) = delete;
+            SimpleMesh(SimpleMesh&& other) noexcept { swap(other); }
+            SimpleMesh& operator=(SimpleMesh&& other) noexcept { swap(other); return *this; } //other deletes what this held
             void setData(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices, bool isInstancedRendered);
 
             //Allocate instances and pass data to graphics pipeline
-            void allocateInstances(std::uint16_t instances);
+            void allocateInstances(std::size_t instances);
             void setInstances(const std::vector<InstanceData>&& instances); //
             void updateInstances();
 
             void setInstancedRendering(bool isInstancedRendered) { m_isInstancedRendered = isInstancedRendered; }
 
+            //Streaming mode: instances go through a persistently mapped StreamBuffer instead of
+            //orphaning and re-uploading the instance VBO. Returns false (and stays in the old
+            //mode) if the context lacks GL 4.4
+            bool setStreaming(bool streaming);
+            bool isStreaming() const { return m_stream.isInit(); }
+
+            //Streaming mode: room for n instances in mapped memory, drawn from the next render on
+            //in place of the current ones; n may not change before the next mapInstances
+            InstanceData* mapInstances(std::size_t n);
+
             void render(const Shader& shader) const;
 
             //Interface with instance data. Must call updateInstances() to pass new data to graphics pipeline
             std::vector<InstanceData> m_instances;
         private:
             void init();
+            void swap(SimpleMesh& other) noexcept;
+            void bindInstanceAttributes(GLuint buffer, std::size_t firstInstance = 0) const;
             bool m_isInit = false;
 
-            bool m_isInstancedRendered;
-            std::uint16_t m_instancesToRender = 0;
+            bool m_isInstancedRendered = false;
+            std::size_t m_instancesToRender = 0;
 
             std::vector<SimpleVertex> m_vertices;
             std::vector<GLuint> m_indices;
             //Add support for textures
 
-            GLuint m_VAO, m_VBO, m_EBO;
-            GLuint m_instancesVBO; //Instancing
+            GLuint m_VAO = 0, m_VBO = 0, m_EBO = 0;
+            GLuint m_instancesVBO = 0; //Instancing
+
+            StreamBuffer m_stream;
+            GLuint m_streamBound = 0;  //stream buffer the instance attributes point at
+            std::size_t m_baseInstance = 0; //first instance of the current partition
+    };
+
+    //Instanced cubes for hits: one HitInstance per cube, positioned by the chip table.
+    //The instance buffer holds a fixed number of slots that are written individually;
+    //the slots up to the highest live one are drawn, and the shader drops the ones whose hit has expired.
+    //The world position of each slot is worked out once, when the slot is written, into a
+    //second buffer: by a compute shader that reads the packed hits and the chip table straight
+    //from their buffers (GL 4.3), or else on the CPU with transformPixels. Both evaluate
+    //(origin + row * rowStep) + col * colStep without fused multiply-adds, so they agree to the bit.
+    class HitMesh{
+        public:
+            static constexpr GLint chipTableUnit = 0; //texture unit of the chip table
+            static constexpr GLint texelsPerChip = sizeof(ChipTableEntry) / sizeof(glm::vec4);
+
+            HitMesh() = default;
+            HitMesh(const std::vector<SimpleVertex>& vertices, const std::vector<GLuint>& indices);
+            ~HitMesh(); //deletes the GL objects, so meshes are moved, never copied
+
+            HitMesh(const HitMesh&) = delete;
+            HitMesh& operator=(const HitMesh&) = delete;
+            HitMesh(HitMesh&& other) noexcept { swap(other); }
+            HitMesh& operator=(HitMesh&& other) noexcept { swap(other); return *this; } //other deletes what this held
+
+            void setChipTable(const std::vector<ChipTableEntry>& chips);
+
+            //Compute mode: slot positions come from the compute shader. False without GL 4.3,
+            //in which case they are computed on the CPU
+            bool setCompute(bool compute);
+            //Checks the compute shader against the CPU on the next slots written and logs the outcome
+            void verifyNextWrite() { m_verifyPending = true; }
+
+            //Grows the buffer to at least slots instances, keeping the contents; new slots are dead
+            void reserveSlots(std::size_t slots);
+            void writeSlots(std::size_t first, const HitInstance* hits, std::size_t n);
+            std::size_t getSlots() const { return m_slots; }
+            //Only slots below n hold live hits; render draws just those
+            void setLiveSlots(std::size_t n) { m_liveSlots = std::min(n, m_slots); }
+
+            //Streaming mode: writeSlots stages the hits in a persistently mapped StreamBuffer and
+            //copies them on the GPU; call beginUpload once per frame before writing. False without GL 4.4
+            bool setStreaming(bool streaming);
+            void beginUpload();
+
+            void render(const Shader& shader) const;
+            //One point per slot instead of a cube, with the hit as a vertex attribute; the
+            //point shader sets the size. Same slots, same culling, a fraction of the vertices
+            void renderPoints(const Shader& shader) const;
+
+        private:
+            void swap(HitMesh& other) noexcept;
+            void bindInstanceAttributes(GLuint buffer, std::size_t firstInstance = 0) const;
+            void bindPointAttributes() const; //the same attributes per vertex, on m_pointVAO
+            void transformSlots(std::size_t first, std::size_t n);      //positions of slots written, on the GPU
+            void transformOnCpu(const HitInstance* hits, std::size_t n); //...or into m_positions
+
+            std::vector<SimpleVertex> m_vertices;
+            std::vector<GLuint> m_indices;
+            std::size_t m_slots = 0;
+            std::size_t m_liveSlots = 0;
+
+            GLuint m_VAO = 0, m_VBO = 0, m_EBO = 0;
+            GLuint m_pointVAO = 0;
+            GLuint m_instancesVBO = 0;
+            GLuint m_positionsVBO = 0; //vec4 per slot: world position of the hit, 1
+            GLuint m_chipBuffer = 0, m_chipTexture = 0;
+            StreamBuffer m_stream;
+
+            std::unique_ptr<Shader> m_transform; //compute mode only
+            bool m_verifyPending = false;
+            std::vector<PixelTransform> m_pixelMaps; //CPU copy of the chip table's pixel maps
+            std::vector<std::uint16_t> m_rows, m_cols;
+            std::vector<float> m_x, m_y, m_z;
+            std::vector<glm::vec4> m_positions;
     };
 }
 
@@ -0,0 +1,117 @@
+#include "OpenGL/Scene/Occupancy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace viz{
+    void OccupancyCounts::add(std::uint16_t row, std::uint16_t col){
+        if(row >= rows || col >= cols) //would write past the counts and widen the dirty rectangle past the texture
+            return;
+
+        std::uint32_t& count = counts[row + (std::size_t)col * rows];
+        count++;
+        maxCount = std::max(maxCount, count);
+
+        dirtyRow0 = std::min(dirtyRow0, row);
+        dirtyRow1 = std::max<std::uint16_t>(dirtyRow1, row + 1);
+        dirtyCol0 = std::min(dirtyCol0, col);
+        dirtyCol1 = std::max<std::uint16_t>(dirtyCol1, col + 1);
+    }
+
+    OccupancyMap::~OccupancyMap(){
+        if(!m_textures.empty())
+            glDeleteTextures(m_textures.size(), m_textures.data());
+        if(m_VAO != 0){
+            glDeleteBuffers(1, &m_VBO);
+            glDeleteVertexArrays(1, &m_VAO);
+        }
+    }
+
+    void OccupancyMap::createQuad(){
+        const glm::vec2 corners[6] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}, {-1.0f, -1.0f}};
+
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void OccupancyMap::addChip(std::uint16_t rows, std::uint16_t cols, const glm::mat4& transform){
+        if(m_VAO == 0)
+            createQuad();
+
+        OccupancyCounts chip;
+        chip.rows = rows;
+        chip.cols = cols;
+        chip.counts.assign((std::size_t)rows * cols, 0);
+        chip.clean();
+
+        //zero filled to begin with, from then on only dirty rectangles are written
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, rows, cols, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, chip.counts.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_counts.push_back(std::move(chip));
+        m_transforms.push_back(transform);
+        m_textures.push_back(texture);
+    }
+
+    void OccupancyMap::fill(int chipId, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        OccupancyCounts& chip = m_counts[chipId];
+        for(std::size_t i = 0; i < n; i++)
+            chip.add(rows[i], cols[i]);
+    }
+
+    void OccupancyMap::upload(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        //rows of the dirty rectangle are strided by the chip's row count in the count array
+        for(std::size_t i = 0; i < m_counts.size(); i++){
+            OccupancyCounts& chip = m_counts[i];
+            m_maxCount = std::max(m_maxCount, chip.maxCount);
+            if(!chip.isDirty())
+                continue;
+
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, chip.rows);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, chip.dirtyRow0, chip.dirtyCol0, chip.dirtyRow1 - chip.dirtyRow0, chip.dirtyCol1 - chip.dirtyCol0,
+                            GL_RED_INTEGER, GL_UNSIGNED_INT, &chip.counts[chip.dirtyRow0 + (std::size_t)chip.dirtyCol0 * chip.rows]);
+            chip.clean();
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void OccupancyMap::render(const Shader& shader, const std::vector<bool>& chips) const {
+        if(m_textures.empty())
+            return;
+
+        shader.use();
+        shader.setInt("uCounts", countsUnit);
+        shader.setFloat("uLogMax", std::log(1.0f + m_maxCount));
+        glActiveTexture(GL_TEXTURE0 + countsUnit);
+
+        glBindVertexArray(m_VAO);
+        for(std::size_t i = 0; i < m_textures.size() && i < chips.size(); i++){
+            if(!chips[i])
+                continue;
+            shader.setMat4("uModel", m_transforms[i]);
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "core/header.h"
+#include "OpenGL/Shader.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mutex>
+
+namespace viz
+{
+    //Hits seen by every pixel of one chip since the start of the run, indexed row + col * rows.
+    //What changed since the last upload is kept as one rectangle, so only that part is re-sent.
+    struct OccupancyCounts{
+        std::uint16_t rows = 0, cols = 0;
+        std::vector<std::uint32_t> counts;
+        std::uint32_t maxCount = 0;
+
+        //Dirty rectangle, half open; empty while dirtyRow0 >= dirtyRow1
+        std::uint16_t dirtyRow0 = 0, dirtyRow1 = 0, dirtyCol0 = 0, dirtyCol1 = 0;
+
+        void add(std::uint16_t row, std::uint16_t col); //0-based; hits outside the chip are ignored
+        bool isDirty() const { return dirtyRow0 < dirtyRow1; }
+        void clean() { dirtyRow0 = rows; dirtyRow1 = 0; dirtyCol0 = cols; dirtyCol1 = 0; }
+    };
+
+    //Accumulated hit map of every chip: one integer texture per chip (GL_R32UI, rows x cols),
+    //drawn on a quad in the chip's mid plane with a log scaled colour map. The counts live on the
+    //CPU and only their dirty rectangles are uploaded, so both upload and draw cost scale with
+    //the chips, not with the hits seen.
+    //fill() is for the processing thread, everything else for the render thread.
+    class OccupancyMap{
+        public:
+            static constexpr GLint countsUnit = 0; //texture unit of the counts
+
+            OccupancyMap() = default;
+            OccupancyMap(const OccupancyMap&) = delete;
+            OccupancyMap& operator=(const OccupancyMap&) = delete;
+            ~OccupancyMap();
+
+            //transform maps the unit square [-1, 1]^2 onto the chip, row along x and col along y
+            void addChip(std::uint16_t rows, std::uint16_t cols, const glm::mat4& transform);
+
+            //Counts a batch of 0-based hits of one chip
+            void fill(int chipId, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n);
+
+            void upload(); //sends the dirty rectangles
+            void render(const Shader& shader, const std::vector<bool>& chips) const; //draws chip i if chips[i]
+
+        private:
+            void createQuad();
+
+            mutable std::mutex m_mutex; //guards the counts
+            std::vector<OccupancyCounts> m_counts;
+            std::vector<glm::mat4> m_transforms;
+            std::vector<GLuint> m_textures;
+            std::uint32_t m_maxCount = 0; //over all chips, as of the last upload
+
+            GLuint m_VAO = 0, m_VBO = 0;
+    };
+}
+
+#endif
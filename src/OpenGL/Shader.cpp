@@ -121,6 +121,21 @@ namespace viz{
         }
     }
 
+    Shader::Shader(const char* name, const char* computeSource){
+        m_name = name;
+
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &computeSource, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+
+        m_id = glCreateProgram();
+        glAttachShader(m_id, compute);
+        glLinkProgram(m_id);
+        checkCompileErrors(m_id, "PROGRAM");
+        glDeleteShader(compute);
+    }
+
     void Shader::checkCompileErrors(GLuint shader, const char* type)
     {
         GLint success;
@@ -15,6 +15,7 @@ namespace viz{
         public:
             Shader() = delete;
             Shader(bool compileFromFile, const char* name, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+            Shader(const char* name, const char* computeSource); //compute program, compiled from a string; needs GL 4.3
 
             inline void use() const {glUseProgram(m_id);}
 
@@ -26,6 +27,10 @@ namespace viz{
                 glUniform1i(glGetUniformLocation(m_id, name), value); 
             }
 
+            inline void setUInt(const char* name, unsigned int value) const{ 
+                glUniform1ui(glGetUniformLocation(m_id, name), value); 
+            }
+
             inline void setFloat(const char* name, float value) const{ 
                 glUniform1f(glGetUniformLocation(m_id, name), value); 
             }
@@ -0,0 +1,71 @@
+#include "OpenGL/StreamBuffer.h"
+
+#include <algorithm>
+
+namespace viz{
+    static constexpr GLbitfield streamFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    void StreamBuffer::init(std::size_t partitionBytes){
+        create(std::max<std::size_t>(partitionBytes, 1));
+    }
+
+    void StreamBuffer::release(){
+        if(m_id == 0)
+            return;
+
+        //unmap only once the GPU is done with every partition. Commands issued since the last
+        //advance() read the current one and are not fenced yet, so they get a fence first
+        if(m_fences[m_current])
+            glDeleteSync(m_fences[m_current]);
+        m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        for(int i = 0; i < partitions; i++)
+            wait(i);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &m_id);
+        m_id = 0;
+        m_mapped = nullptr;
+    }
+
+    void StreamBuffer::create(std::size_t partitionBytes){
+        release();
+
+        m_partitionSize = partitionBytes;
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, partitions * m_partitionSize, nullptr, streamFlags);
+        m_mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, partitions * m_partitionSize, streamFlags));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        m_current = 0;
+        m_used = 0;
+    }
+
+    void StreamBuffer::wait(int partition){
+        GLsync& fence = m_fences[partition];
+        if(!fence)
+            return;
+        while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    void StreamBuffer::advance(){
+        if(m_fences[m_current])
+            glDeleteSync(m_fences[m_current]);
+        m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        m_current = (m_current + 1) % partitions;
+        m_used = 0;
+        wait(m_current);
+    }
+
+    void* StreamBuffer::allocate(std::size_t bytes, std::size_t& offset){
+        if(m_used + bytes > m_partitionSize)
+            create(std::max(2 * m_partitionSize, m_used + bytes)); //waits for every command issued so far, see release()
+
+        offset = m_current * m_partitionSize + m_used;
+        m_used += bytes;
+        return m_mapped + offset;
+    }
+}
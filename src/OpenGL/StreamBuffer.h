@@ -0,0 +1,50 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "core/header.h"
+#include <glad/glad.h>
+
+namespace viz
+{
+    //Persistently mapped buffer split into partitions that are written in turn, one per
+    //update. advance() fences the commands issued so far, which read the partition just
+    //finished, and waits only if the GPU still reads the partition it moves on to; with
+    //three partitions that is two updates back, so in practice it never waits. Needs
+    //GL 4.4 (glBufferStorage); check isSupported() first.
+    class StreamBuffer{
+        public:
+            static constexpr int partitions = 3;
+            static bool isSupported() { return GLAD_GL_VERSION_4_4; }
+
+            void init(std::size_t partitionBytes);
+            void release(); //waits for the GPU, then unmaps and deletes the buffer; the owner calls it, there is no destructor
+
+            //Starts the next partition; call before the first allocate of an update
+            void advance();
+
+            //Room for bytes in the current partition, written straight into mapped memory.
+            //offset is the byte offset in the buffer, e.g. for a draw's base instance or a copy;
+            //for base instances keep the partition size and every allocation a multiple of the
+            //instance size.
+            //A partition too small is grown first, which waits for the GPU and replaces the
+            //buffer: re-fetch getID() after allocating.
+            void* allocate(std::size_t bytes, std::size_t& offset);
+
+            GLuint getID() const { return m_id; }
+            std::size_t getPartitionSize() const { return m_partitionSize; }
+            bool isInit() const { return m_id != 0; }
+
+        private:
+            void create(std::size_t partitionBytes);
+            void wait(int partition);
+
+            GLuint m_id = 0;
+            char* m_mapped = nullptr;
+            std::size_t m_partitionSize = 0;
+            std::size_t m_used = 0; //bytes of the current partition handed out
+            int m_current = 0;
+            GLsync m_fences[partitions] = {};
+    };
+}
+
+#endif
@@ -123,8 +123,6 @@ namespace viz
                         }else{ //otherwise displace
                             cam->smoothDisplace(-disp, m_renderer->getDelTime());
                         }
-
-                        m_renderer->sortTransparentObjects();
                     }
                 }  
                 else{
@@ -138,7 +136,6 @@ namespace viz
                     Camera* cam = m_renderer->getCamera();
 
                     cam->displace(cam->getFront() * 0.75f * e.getData()->floatPairedData.second);
-                    m_renderer->sortTransparentObjects();
                 }
                 return;
             }
@@ -170,6 +167,10 @@ namespace viz
         }else{
             startCLI = false;
         }
+
+        bool heatmap = m_renderer->getDetector()->getDisplayMode() == DisplayMode::Heatmap;
+        if(ImGui::Checkbox("Occupancy heatmap", &heatmap))
+            m_renderer->getDetector()->setDisplayMode(heatmap ? DisplayMode::Heatmap : DisplayMode::Hits);
         
         std::vector<Chip> chips = m_renderer->getDetector()->getChips();
         for(int i = 0; i < chips.size(); i++){
@@ -178,6 +179,16 @@ namespace viz
             ImGui::Text("fe_id: %i", chips[i].fe_id);
             ImGui::Text("Position: (%.2f, %.2f, %.2f)", chips[i].pos.x, chips[i].pos.y, chips[i].pos.z);
             ImGui::Text("Hits: %lu", chips[i].hits);
+
+            MemoryStats mem = m_renderer->getDetector()->getMemoryStats(chips[i].fe_id);
+            ImVec4 memColor = mem.overBudget() ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+            ImGui::TextColored(memColor, "Memory: %.1f KiB / %zu hits in flight", mem.totalBytes() / 1024.0, mem.totalHits());
+            if(mem.budget > 0)
+                ImGui::Text("  budget: %.1f KiB", mem.budget / 1024.0);
+            ImGui::Text("  loader:    %.1f KiB / %zu hits", mem.loaderBytes / 1024.0, mem.loaderHits);
+            ImGui::Text("  clipboard: %.1f KiB / %zu hits (%zu blocks)", mem.clipboardBytes / 1024.0, mem.clipboardHits, mem.clipboardBlocks);
+            ImGui::Text("  builder:   %.1f KiB / %zu hits", mem.builderBytes / 1024.0, mem.builderHits);
+            ImGui::Text("  detector:  %.1f KiB / %zu hits", mem.consumerBytes / 1024.0, mem.consumerHits);
         }
 
         
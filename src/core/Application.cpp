@@ -25,6 +25,7 @@ namespace viz
     }  
 
     void Application::init(){
+        m_cli->pinCurrentThread("render");
         m_detector = std::make_unique<Detector>();
         m_renderer = std::make_unique<Renderer>(0,0);
 
@@ -83,10 +84,11 @@ namespace viz
     }
 
     void Application::onEvent(event& e){
-        if(e.getEventType() == eventType::particleHit){
+        //one line per frame with hits, see HitSummary
+        if(e.getEventType() == eventType::hitSummary){
             std::string str = e.toString();
             ConsoleWindow* console = dynamic_cast<ConsoleWindow*>(m_GUIWindows[2].get());
-            console->AddLog(str.c_str());
+            console->AddLog("%s", str.c_str());
         }
 
         for(int i = 0 ; i < m_GUIWindows.size(); i++){
@@ -0,0 +1,105 @@
+#include <string>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "DataBase.h"
+#include "EventBuilder.h"
+#include "ShardedEventBuilder.h"
+#include "cli.h"
+
+// Event building throughput with many FEs: the single-threaded EventBuilder
+// against the ShardedEventBuilder with 1..N shard threads. Every FE streams
+// blocks covering the same bcid range; a collect follows each round of blocks,
+// as the Detector does. Generating the blocks is not timed.
+//
+// usage: builderbench [FEs] [bunch crossings] [max threads]
+
+namespace
+{
+    auto logger = logging::make_log("BuilderBench");
+}
+
+struct BenchResult {
+    double seconds;
+    std::size_t events, bunches;
+};
+
+// rounds[r][fe]: the block fe delivers in round r
+static std::vector<std::vector<EventData>> makeRounds(std::size_t nFEs, std::size_t nBcids, std::size_t bcidsPerRound) {
+    std::mt19937 rng(42);
+    std::vector<std::vector<EventData>> rounds;
+    for(std::size_t first = 0; first < nBcids; first += bcidsPerRound) {
+        rounds.emplace_back(nFEs);
+        for(std::size_t fe = 0; fe < nFEs; fe++) {
+            EventData& block = rounds.back()[fe];
+            for(std::size_t bcid = first; bcid < std::min(nBcids, first + bcidsPerRound); bcid++) {
+                if(rng() % 4 != 0) // a quarter of the crossings leave something in a given FE
+                    continue;
+                block.newEvent(0, bcid, bcid & 0xFFFF);
+                for(unsigned h = 0; h < 1 + rng() % 4; h++)
+                    block.addHit(rng() % 384, rng() % 400, 1);
+            }
+        }
+    }
+    return rounds;
+}
+
+static BenchResult runOnce(EventBuilder& builder, std::vector<std::vector<EventData>> rounds) {
+    std::size_t events = 0;
+    for(const auto& round : rounds)
+        for(const auto& block : round)
+            events += block.events.size();
+
+    std::vector<ReconstructedBunch> out;
+    auto start = std::chrono::steady_clock::now();
+    for(auto& round : rounds) {
+        for(std::size_t fe = 0; fe < round.size(); fe++)
+            builder.add(fe, std::move(round[fe]));
+        builder.collect(out);
+    }
+    builder.flush(out);
+    auto stop = std::chrono::steady_clock::now();
+
+    return {std::chrono::duration<double>(stop - start).count(), events, out.size()};
+}
+
+static void report(const std::string& name, const BenchResult& res, double baseline) {
+    logger->info("{:<20} {:>9} events, {:>7} bunches in {:.4f} s = {:>7.2f} M events/s, speedup {:.2f}",
+        name, res.events, res.bunches, res.seconds, res.events / res.seconds / 1e6, baseline / res.seconds);
+}
+
+int main(int argc, char** argv) {
+    std::size_t nFEs = 100;
+    std::size_t nBcids = 20000;
+    std::size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    if(argc > 1) nFEs = std::stoul(argv[1]);
+    if(argc > 2) nBcids = std::stoul(argv[2]);
+    if(argc > 3) maxThreads = std::stoul(argv[3]);
+
+    cli_helpers::setupLoggers(false);
+
+    json config;
+    config["timeout"] = 1000;
+    config["window"] = nBcids;
+
+    auto rounds = makeRounds(nFEs, nBcids, 1000);
+    logger->info("{} hardware threads, {} FEs, {} bunch crossings in {} rounds", std::thread::hardware_concurrency(), nFEs, nBcids, rounds.size());
+
+    for(int round = 0; round < 2; round++) {
+        BenchResult single;
+        {
+            EventBuilder builder(nFEs);
+            builder.configure(config);
+            single = runOnce(builder, rounds);
+            report("single-threaded", single, single.seconds);
+        }
+        for(std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            ShardedEventBuilder builder(nFEs, threads);
+            builder.configure(config);
+            report("sharded x" + std::to_string(threads), runOnce(builder, rounds), single.seconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "DataBase.h"
+#include "cli.h"
+
+// Throughput of ClipBoard<EventData> with one producer and one consumer thread
+// hammering it concurrently: mutex+deque versus the lock-free SPSC ring.
+// Blocks are allocated up front so only the hand-over itself is timed.
+//
+// usage: clipboardbench [blocks] [ring capacity]
+
+namespace
+{
+    auto logger = logging::make_log("ClipBoardBench");
+}
+
+struct BenchResult {
+    double seconds;
+    std::size_t blocks;
+};
+
+static BenchResult runOnce(ClipBoard<EventData>& clipboard, std::vector<std::unique_ptr<EventData>>& blocks) {
+    const std::size_t total = blocks.size();
+    std::vector<std::unique_ptr<EventData>> received;
+    received.reserve(total);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        for(std::size_t i = 0; i < total; i++)
+            clipboard.pushData(std::move(blocks[i]));
+    });
+
+    while(received.size() < total) {
+        std::unique_ptr<EventData> block = clipboard.popData();
+        if(block)
+            received.push_back(std::move(block));
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    // hand the blocks back for the next round
+    for(std::size_t i = 0; i < total; i++)
+        blocks[i] = std::move(received[i]);
+
+    return {std::chrono::duration<double>(stop - start).count(), total};
+}
+
+static void report(const std::string& name, const BenchResult& res) {
+    logger->info("{:<24} {:>10} blocks in {:.4f} s = {:>8.1f} ns/block, {:>6.2f} M blocks/s",
+        name, res.blocks, res.seconds, 1e9 * res.seconds / res.blocks, res.blocks / res.seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+    std::size_t nBlocks = 1 << 20;
+    std::size_t capacity = 1024;
+    if(argc > 1) nBlocks = std::stoul(argv[1]);
+    if(argc > 2) capacity = std::stoul(argv[2]);
+
+    cli_helpers::setupLoggers(false);
+
+    std::vector<std::unique_ptr<EventData>> blocks(nBlocks);
+    for(auto& block : blocks) {
+        block = std::make_unique<EventData>();
+        block->newEvent(0, 0, 0);
+        block->addHit(1, 1, 1);
+    }
+
+    logger->info("{} hardware threads, {} blocks per run", std::thread::hardware_concurrency(), nBlocks);
+    for(int round = 0; round < 3; round++) {
+        {
+            ClipBoard<EventData> clipboard;
+            report("mutex+deque", runOnce(clipboard, blocks));
+        }
+        {
+            ClipBoard<EventData> clipboard(capacity);
+            report("spsc ring (" + std::to_string(capacity) + ")", runOnce(clipboard, blocks));
+        }
+        {
+            ClipBoard<EventData> clipboard(16);
+            report("spsc ring (16)", runOnce(clipboard, blocks));
+        }
+    }
+    return 0;
+}
@@ -43,16 +43,21 @@ int main(int argc, char** argv) {
             sleepTime = allConf["viz_config"]["frame_time"];
         }
     }
+    cli.pinCurrentThread("builder"); // this loop is the consumer stage
     while(signaled == 0) {
 
         // MAIN EVENT LOOP HERE
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
+        // block until some FE pushed data; frame_time is only the upper bound on the wait
+        if(!cli.waitForData(std::chrono::milliseconds(sleepTime)))
+            continue;
 
         // collect and count data
         long int size = 0;
         int nfe= 0;
         
         for(int i = 0; i < cli.getTotalFEs(); i++) {
+            if(!cli.hasData(i))
+                continue;
             std::unique_ptr<std::vector<pixelHit>> data = cli.getData(i, true);
             if(data){
                 size += data->size();
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/header.h"
+#include "mathtools.h"
+#include "cli.h"
+
+// Pixel to world transform of hit blocks: the per-hit quaternion and matrix products
+// the Detector used to do, against the precomputed per-chip PixelTransform with the
+// scalar and the SIMD kernel. Every variant produces the full model matrix of each
+// hit, as the Detector needs it. Generating the blocks is not timed.
+//
+// usage: transformbench [hits per block] [blocks]
+
+namespace
+{
+    auto logger = logging::make_log("TransformBench");
+
+    const glm::vec3 chipPos(1.5f, -2.0f, 4.0f), chipRot(30.0f, 15.0f, 60.0f), chipScale(2.0f, 2.1f, 0.1f);
+    const std::uint16_t maxRows = 384, maxCols = 400;
+}
+
+// The old Detector::spawnHit
+static glm::mat4 legacyModel(std::uint16_t row, std::uint16_t col) {
+    float hitSize = (1.0f / std::min(maxRows, maxCols)) * chipScale[0];
+    float diffx = (2.0f * ((float)row / (float)maxRows) - 1.0f) * chipScale[0];
+    float diffy = (2.0f * ((float)col / (float)maxCols) - 1.0f) * chipScale[1];
+    glm::vec3 rad(viz_TO_RADIANS(chipRot[0]), viz_TO_RADIANS(chipRot[1]), viz_TO_RADIANS(chipRot[2]));
+    glm::vec3 pos = chipPos + glm::toMat3(glm::quat(rad)) * glm::vec3(diffx, diffy, 0.0f);
+
+    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(hitSize, hitSize, chipScale[2] + 0.1f));
+    model = glm::toMat4(glm::quat(rad)) * model;
+    return glm::translate(glm::mat4(1.0f), pos) * model;
+}
+
+// As Detector::computeChipTransform
+static void precompute(viz::PixelTransform& map, glm::mat3& basis) {
+    glm::mat3 rot = glm::toMat3(glm::quat(glm::vec3(viz_TO_RADIANS(chipRot[0]), viz_TO_RADIANS(chipRot[1]), viz_TO_RADIANS(chipRot[2]))));
+    glm::vec3 origin = chipPos - rot * glm::vec3(chipScale[0], chipScale[1], 0.0f);
+    glm::vec3 rowStep = rot * glm::vec3(2.0f * chipScale[0] / maxRows, 0.0f, 0.0f);
+    glm::vec3 colStep = rot * glm::vec3(0.0f, 2.0f * chipScale[1] / maxCols, 0.0f);
+    for(int k = 0; k < 3; k++) {
+        map.origin[k] = origin[k];
+        map.rowStep[k] = rowStep[k];
+        map.colStep[k] = colStep[k];
+    }
+    float hitSize = (1.0f / std::min(maxRows, maxCols)) * chipScale[0];
+    basis = rot * glm::mat3(glm::vec3(hitSize, 0.0f, 0.0f), glm::vec3(0.0f, hitSize, 0.0f), glm::vec3(0.0f, 0.0f, chipScale[2] + 0.1f));
+}
+
+using Kernel = void (*)(const viz::PixelTransform&, const std::uint16_t*, const std::uint16_t*, std::size_t, float*, float*, float*);
+
+int main(int argc, char** argv) {
+    std::size_t blockSize = 1 << 20;
+    std::size_t nBlocks = 10;
+    if(argc > 1) blockSize = std::stoul(argv[1]);
+    if(argc > 2) nBlocks = std::stoul(argv[2]);
+
+    cli_helpers::setupLoggers(false);
+
+    std::mt19937 rng(42);
+    std::vector<std::uint16_t> rows(blockSize), cols(blockSize);
+    for(std::size_t i = 0; i < blockSize; i++) {
+        rows[i] = rng() % maxRows;
+        cols[i] = rng() % maxCols;
+    }
+
+    viz::PixelTransform map;
+    glm::mat3 basis;
+    precompute(map, basis);
+
+    std::vector<glm::mat4> legacy(blockSize), models(blockSize);
+    std::vector<float> x(blockSize), y(blockSize), z(blockSize);
+    logger->info("{} blocks of {} hits", nBlocks, blockSize);
+
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t b = 0; b < nBlocks; b++)
+        for(std::size_t i = 0; i < blockSize; i++)
+            legacy[i] = legacyModel(rows[i], cols[i]);
+    double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double total = double(blockSize) * nBlocks;
+    logger->info("{:<22} {:>8.2f} M hits/s", "per-hit quaternions", total / legacySeconds / 1e6);
+
+    std::vector<float> scalar; //x, y and z of the first variant
+    for(auto variant : {std::make_pair("precomputed, scalar", Kernel(viz::transformPixelsScalar)), std::make_pair("precomputed, SIMD", Kernel(viz::transformPixels))}) {
+        double kernelSeconds = 0;
+        start = std::chrono::steady_clock::now();
+        for(std::size_t b = 0; b < nBlocks; b++) {
+            auto kernelStart = std::chrono::steady_clock::now();
+            variant.second(map, rows.data(), cols.data(), blockSize, x.data(), y.data(), z.data());
+            kernelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - kernelStart).count();
+
+            glm::mat4 model(basis);
+            for(std::size_t i = 0; i < blockSize; i++) {
+                model[3] = glm::vec4(x[i], y[i], z[i], 1.0f);
+                models[i] = model;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        float maxDiff = 0;
+        for(std::size_t i = 0; i < blockSize; i++)
+            for(int c = 0; c < 4; c++)
+                for(int r = 0; r < 3; r++)
+                    maxDiff = std::max(maxDiff, std::fabs(models[i][c][r] - legacy[i][c][r]));
+
+        logger->info("{:<22} {:>8.2f} M hits/s, kernel alone {:>8.2f} M hits/s, speedup {:.1f}, max. deviation {:.2e}",
+            variant.first, total / seconds / 1e6, total / kernelSeconds / 1e6, legacySeconds / seconds, maxDiff);
+
+        std::vector<float> xyz(x);
+        xyz.insert(xyz.end(), y.begin(), y.end());
+        xyz.insert(xyz.end(), z.begin(), z.end());
+        if(scalar.empty())
+            scalar.swap(xyz);
+        else if(scalar != xyz)
+            logger->error("the SIMD kernel does not match the scalar one");
+    }
+    return 0;
+}
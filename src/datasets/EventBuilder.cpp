@@ -0,0 +1,326 @@
+#include "EventBuilder.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+    auto logger = logging::make_log("EventBuilder");
+}
+
+EventBuilder::EventBuilder(std::size_t arg_totalFEs) : totalFEs(arg_totalFEs), fes(arg_totalFEs) {}
+
+EventBuilder::~EventBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(calMutex);
+        calStop = true;
+    }
+    calCv.notify_all();
+    if(calThread.joinable())
+        calThread.join();
+}
+
+void EventBuilder::configure(const json &config) {
+    if(config.contains("timeout"))
+        timeout = std::chrono::milliseconds((int)config["timeout"]);
+    if(config.contains("window"))
+        window = std::max<std::size_t>(1, (std::size_t)config["window"]);
+
+    if(config.contains("match")) {
+        if(config["match"] == "composite")
+            matching = Matching::Composite;
+        else if(config["match"] == "bcid")
+            matching = Matching::Bcid;
+        else
+            throw std::invalid_argument("event_builder match must be \"bcid\" or \"composite\"");
+    }
+
+    if(config.contains("calibration")) {
+        const json &cal = config["calibration"];
+        if(cal.contains("interval"))
+            calInterval = std::chrono::milliseconds((int)cal["interval"]);
+        if(cal.contains("samples"))
+            calSamples = std::max<std::size_t>(1, (std::size_t)cal["samples"]);
+        if(cal.contains("max_offset"))
+            calMaxOffset = std::max<int64_t>(0, (int64_t)cal["max_offset"]);
+        if(cal.contains("min_pairs"))
+            calMinPairs = std::max<std::size_t>(1, (std::size_t)cal["min_pairs"]);
+    }
+
+    if(matching == Matching::Composite && !calThread.joinable()) {
+        hitTimes.assign(totalFEs, viz::CircularBuffer<uint32_t>(calSamples));
+        nextCalibration = clock::now() + calInterval;
+        calThread = std::thread(&EventBuilder::calibrationLoop, this);
+        logger->info("Composite (tag, l1id, bcid) matching for {} FEs, offsets re-estimated every {} ms within +-{} bcids",
+            totalFEs, calInterval.count(), calMaxOffset);
+    }
+}
+
+// For events without a timeline timestamp. The bcid counter wraps every 2^bcidBits
+// crossings. Each new value is placed at the unwrapped key closest to the newest one
+// of its FE, so steps of less than half a period either way are followed across a
+// wrap. An FE seen for the first time is placed next to the newest key of all FEs so
+// that every stream shares one epoch.
+uint64_t EventBuilder::unwrap(FeState &fe, uint32_t bcid) {
+    constexpr uint64_t period = uint64_t(1) << bcidBits;
+    uint64_t ref = fe.seen ? fe.last : std::max(newest, period); //keys start one period in, so stepping back never underflows
+
+    uint64_t delta = (bcid - ref) & (period - 1);
+    uint64_t key = (delta < period / 2) ? ref + delta : ref - (period - delta);
+
+    if(!fe.seen || key > fe.last)
+        fe.last = key;
+    fe.seen = true;
+    newest = std::max(newest, key);
+    return key;
+}
+
+// Events stamped by the loader's EventTimeline already carry a monotonic timestamp; it only
+// needs the shift into the shared epoch, which the first event of the FE determines
+uint64_t EventBuilder::align(FeState &fe, const Event &event) {
+    if(!fe.seen) {
+        uint64_t key = unwrap(fe, event.bcid);
+        fe.shift = key - event.timestamp;
+        return key;
+    }
+
+    uint64_t key = event.timestamp + fe.shift;
+    fe.last = std::max(fe.last, key);
+    newest = std::max(newest, key);
+    return key;
+}
+
+BunchKey EventBuilder::keyOf(uint16_t fe_id, const Event &event) {
+    FeState &fe = fes[fe_id];
+    uint64_t ubcid = event.timestamp ? align(fe, event) : unwrap(fe, event.bcid);
+
+    BunchKey key;
+    key.time = ubcid - fe.bcidOffset;
+    if(matching == Matching::Composite) {
+        if(event.nHits > 0)
+            hitTimes[fe_id].push(ubcid, event.l1id);
+        key.l1id = (event.l1id - fe.l1idOffset) & ((uint32_t(1) << l1idBits) - 1);
+        key.tag = event.tag;
+    }
+    return key;
+}
+
+void EventBuilder::insert(uint16_t fe_id, const BunchKey &key, Event &&event, clock::time_point now) {
+    if(!lastBunch || !(key == lastKey)) {
+        auto it = open.find(key);
+        if(it == open.end()) {
+            if(key.time < emittedBelow)
+                stats.lateEvents++; //its bunch is gone; the event goes out in a partial bunch of its own
+            it = open.emplace(key, OpenBunch{ReconstructedBunch(key.time & ((uint64_t(1) << bcidBits) - 1), totalFEs), now}).first;
+            it->second.bunch.timestamp = key.time;
+            order.push(key);
+        }
+        lastBunch = &it->second; //element references survive rehashing
+        lastKey = key;
+    }
+
+    FeState &fe = fes[fe_id];
+    fe.bytes += sizeof(Event) + event.nHits * sizeof(Hit);
+    fe.hits += event.nHits;
+    lastBunch->bunch.addMatchedEvent(std::move(event), fe_id);
+}
+
+void EventBuilder::add(uint16_t fe_id, EventData &&block, clock::time_point now) {
+    if(fe_id >= totalFEs)
+        return;
+
+    for(Event &event : block.events)
+        insert(fe_id, keyOf(fe_id, event), std::move(event), now);
+}
+
+uint64_t EventBuilder::completedBelow() const {
+    uint64_t below = UINT64_MAX;
+    for(const FeState &fe : fes)
+        below = std::min<uint64_t>(below, fe.seen ? fe.last - fe.bcidOffset : 0); //an FE that never sent anything holds everything until the timeout
+    return below;
+}
+
+void EventBuilder::emit(const BunchKey &key, std::vector<ReconstructedBunch> &out) {
+    auto it = open.find(key);
+    ReconstructedBunch &bunch = it->second.bunch;
+
+    for(uint16_t i = 0; i < totalFEs; i++) {
+        const EventData &feData = bunch.peekEventDataFE(i);
+        fes[i].bytes -= feData.events.size() * sizeof(Event) + feData.nHits * sizeof(Hit);
+        fes[i].hits -= feData.nHits;
+    }
+
+    if(lastBunch == &it->second)
+        lastBunch = nullptr;
+    out.push_back(std::move(bunch));
+    open.erase(it);
+    emittedBelow = std::max(emittedBelow, key.time);
+    stats.bunches++;
+}
+
+void EventBuilder::calibrate(clock::time_point now) {
+    if(matching != Matching::Composite)
+        return;
+    applyCalibration();
+    if(now >= nextCalibration)
+        startCalibration(now);
+}
+
+std::size_t EventBuilder::release(std::vector<ReconstructedBunch> &out, clock::time_point now, uint64_t doneBelow) {
+    std::size_t n = 0;
+    while(!order.empty()) {
+        BunchKey key = order.top();
+        if(key.time < doneBelow || key.time < emittedBelow)
+            stats.complete++;
+        else if(now - open.at(key).firstSeen >= timeout)
+            stats.timedOut++;
+        else if(open.size() > window)
+            stats.overflowed++;
+        else
+            break;
+
+        order.pop();
+        emit(key, out);
+        n++;
+    }
+    return n;
+}
+
+std::size_t EventBuilder::collect(std::vector<ReconstructedBunch> &out, clock::time_point now) {
+    calibrate(now);
+    return release(out, now, completedBelow());
+}
+
+std::size_t EventBuilder::flush(std::vector<ReconstructedBunch> &out) {
+    std::size_t n = open.size();
+    while(!order.empty()) {
+        BunchKey key = order.top();
+        order.pop();
+        emit(key, out);
+    }
+    return n;
+}
+
+// Hands a copy of the hit times to the calibration thread unless it is still busy
+void EventBuilder::startCalibration(clock::time_point now) {
+    nextCalibration = now + calInterval;
+
+    std::unique_lock<std::mutex> lock(calMutex);
+    if(calBusy)
+        return;
+    calInput.assign(totalFEs, {});
+    for(std::size_t i = 0; i < totalFEs; i++) {
+        calInput[i].reserve(hitTimes[i].size());
+        for(std::size_t j = 0; j < hitTimes[i].size(); j++)
+            calInput[i].emplace_back(hitTimes[i].keyAt(j), hitTimes[i][j]);
+    }
+    calBusy = true;
+    lock.unlock();
+    calCv.notify_one();
+}
+
+void EventBuilder::applyCalibration() {
+    if(!calReady.exchange(false))
+        return;
+
+    std::lock_guard<std::mutex> lock(calMutex);
+    for(std::size_t i = 0; i < totalFEs; i++) {
+        if(!calResult.found[i])
+            continue;
+        FeState &fe = fes[i];
+        if(fe.bcidOffset != calResult.bcid[i] || fe.l1idOffset != calResult.l1id[i]) {
+            logger->info("FE {}: bcid offset {} -> {}, l1id offset {} -> {}", i, fe.bcidOffset, calResult.bcid[i], fe.l1idOffset, calResult.l1id[i]);
+            fe.bcidOffset = calResult.bcid[i];
+            fe.l1idOffset = calResult.l1id[i];
+        }
+    }
+    stats.calibrations++;
+}
+
+void EventBuilder::calibrationLoop() {
+    std::unique_lock<std::mutex> lock(calMutex);
+    while(true) {
+        calCv.wait(lock, [this] { return calStop || (calBusy && !calInput.empty()); });
+        if(calStop)
+            break;
+
+        std::vector<std::vector<std::pair<uint64_t, uint32_t>>> input = std::move(calInput);
+        calInput.clear();
+        lock.unlock();
+
+        Offsets result = estimateOffsets(input);
+
+        lock.lock();
+        calResult = std::move(result);
+        calBusy = false;
+        calReady = true;
+    }
+}
+
+// Cross-correlates the hit times of every FE with those of the reference FE: each pair of
+// hits closer than max_offset votes for its bcid difference. A particle crossing the
+// telescope hits several FEs in the same bunch crossing, so the true offset stands out
+// against the flat background of unrelated pairs. The l1id offset is the most common
+// l1id difference among the pairs at that bcid offset.
+EventBuilder::Offsets EventBuilder::estimateOffsets(const std::vector<std::vector<std::pair<uint64_t, uint32_t>>> &input) const {
+    Offsets result;
+    result.found.assign(totalFEs, false);
+    result.bcid.assign(totalFEs, 0);
+    result.l1id.assign(totalFEs, 0);
+
+    std::size_t ref = 0;
+    while(ref < totalFEs && input[ref].size() < calMinPairs)
+        ref++;
+    if(ref == totalFEs)
+        return result;
+    result.found[ref] = true;
+
+    std::vector<std::pair<uint64_t, uint32_t>> refTimes = input[ref];
+    std::sort(refTimes.begin(), refTimes.end());
+
+    const uint32_t l1Mask = (uint32_t(1) << l1idBits) - 1;
+    std::vector<std::size_t> votes(2 * calMaxOffset + 1);
+
+    for(std::size_t i = 0; i < totalFEs; i++) {
+        if(i == ref || input[i].size() < calMinPairs)
+            continue;
+
+        std::vector<std::pair<uint64_t, uint32_t>> times = input[i];
+        std::sort(times.begin(), times.end());
+
+        std::fill(votes.begin(), votes.end(), 0);
+        std::size_t pairs = 0, lo = 0;
+        for(const auto &hit : times) {
+            while(lo < refTimes.size() && refTimes[lo].first + calMaxOffset < hit.first)
+                lo++;
+            for(std::size_t j = lo; j < refTimes.size() && refTimes[j].first <= hit.first + calMaxOffset; j++) {
+                votes[hit.first - refTimes[j].first + calMaxOffset]++;
+                pairs++;
+            }
+        }
+
+        std::size_t peak = std::max_element(votes.begin(), votes.end()) - votes.begin();
+        // significant if well above the mean vote of a lag
+        if(votes[peak] < calMinPairs || votes[peak] * votes.size() < 5 * pairs)
+            continue;
+        int64_t bcidOffset = (int64_t)peak - calMaxOffset;
+
+        std::map<uint32_t, std::size_t> l1Votes;
+        lo = 0;
+        for(const auto &hit : times) {
+            while(lo < refTimes.size() && (int64_t)(refTimes[lo].first + bcidOffset) < (int64_t)hit.first)
+                lo++;
+            for(std::size_t j = lo; j < refTimes.size() && (int64_t)(refTimes[j].first + bcidOffset) == (int64_t)hit.first; j++)
+                l1Votes[(hit.second - refTimes[j].second) & l1Mask]++;
+        }
+        auto l1Peak = std::max_element(l1Votes.begin(), l1Votes.end(),
+            [](const std::pair<const uint32_t, std::size_t> &a, const std::pair<const uint32_t, std::size_t> &b) { return a.second < b.second; });
+
+        result.found[i] = true;
+        result.bcid[i] = bcidOffset;
+        result.l1id[i] = l1Peak->first;
+    }
+    return result;
+}
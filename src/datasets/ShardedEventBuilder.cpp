@@ -0,0 +1,224 @@
+#include "ShardedEventBuilder.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <queue>
+
+ShardedEventBuilder::ShardedEventBuilder(std::size_t arg_totalFEs, std::size_t nShards, std::function<void(std::size_t)> onWorkerStart)
+    : EventBuilder(arg_totalFEs), inbox(std::max<std::size_t>(1, nShards)), heldFeBytes(arg_totalFEs, 0), heldFeHits(arg_totalFEs, 0),
+      pool(std::max<std::size_t>(1, nShards), onWorkerStart) {
+    for(std::size_t i = 0; i < inbox.size(); i++)
+        shards.push_back(std::make_unique<EventBuilder>(arg_totalFEs));
+}
+
+ShardedEventBuilder::~ShardedEventBuilder() = default;
+
+// The base class does the keying (matching mode, offset calibration); the shards only
+// hold bunches, so they get the timeout. The window is enforced over all shards in collect()
+void ShardedEventBuilder::configure(const json &config) {
+    EventBuilder::configure(config);
+
+    json shardConfig = config;
+    shardConfig.erase("match");
+    shardConfig.erase("calibration");
+    shardConfig.erase("window");
+    for(auto &shard : shards) {
+        shard->configure(shardConfig);
+        shard->window = std::numeric_limits<std::size_t>::max();
+    }
+}
+
+void ShardedEventBuilder::add(uint16_t fe_id, EventData &&block, clock::time_point now) {
+    if(fe_id >= totalFEs || block.empty())
+        return;
+
+    pending.push_back(std::move(block)); //moving keeps the event storage, so the pointers below stay valid
+    for(Event &event : pending.back().events) {
+        BunchKey key = keyOf(fe_id, event);
+        inbox[key.time % shards.size()].push_back({fe_id, key, &event, now});
+    }
+}
+
+void ShardedEventBuilder::forEachShard(const std::function<void(std::size_t)> &work) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t remaining = shards.size();
+
+    for(std::size_t i = 0; i < shards.size(); i++) {
+        pool.submit([&, i]() {
+            work(i);
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--remaining == 0)
+                cv.notify_one();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return remaining == 0; });
+}
+
+// Each part is ordered already; a k-way merge on the bunch time keeps it that way. Bunches
+// with the same time always come from the same shard, so their order is preserved too
+void ShardedEventBuilder::merge(std::vector<std::vector<ReconstructedBunch>> &parts, std::vector<ReconstructedBunch> &out) const {
+    using Head = std::pair<uint64_t, std::size_t>; //time of the next bunch, shard
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::vector<std::size_t> next(parts.size(), 0);
+
+    std::size_t total = 0;
+    for(std::size_t i = 0; i < parts.size(); i++) {
+        total += parts[i].size();
+        if(!parts[i].empty())
+            heads.push({parts[i].front().timestamp, i});
+    }
+    out.reserve(out.size() + total);
+
+    while(!heads.empty()) {
+        std::size_t i = heads.top().second;
+        heads.pop();
+        out.push_back(std::move(parts[i][next[i]++]));
+        if(next[i] < parts[i].size())
+            heads.push({parts[i][next[i]].timestamp, i});
+    }
+}
+
+// Skewed traffic can fill one shard long before the others, so the window is the
+// sum over all of them. Each step overflows the oldest open bunch of any shard,
+// which is what a single EventBuilder would give up first
+void ShardedEventBuilder::limitWindow(std::vector<std::vector<ReconstructedBunch>> &parts) {
+    std::size_t total = openBunches();
+    while(total > window) {
+        std::size_t oldest = 0;
+        for(std::size_t i = 1; i < shards.size(); i++) {
+            if(shards[i]->oldestOpen() < shards[oldest]->oldestOpen())
+                oldest = i;
+        }
+        EventBuilder &shard = *shards[oldest];
+        BunchKey key = shard.order.top();
+        shard.order.pop();
+        shard.emit(key, parts[oldest]);
+        shard.stats.overflowed++;
+        total--;
+    }
+}
+
+void ShardedEventBuilder::hold(std::vector<std::vector<ReconstructedBunch>> &parts) {
+    std::vector<ReconstructedBunch> released;
+    merge(parts, released);
+    if(released.empty())
+        return;
+
+    for(const ReconstructedBunch &bunch : released) {
+        for(uint16_t i = 0; i < totalFEs; i++) {
+            const EventData &feData = bunch.peekEventDataFE(i);
+            heldFeBytes[i] += feData.events.size() * sizeof(Event) + feData.nHits * sizeof(Hit);
+            heldFeHits[i] += feData.nHits;
+        }
+    }
+
+    //on equal times the bunch held already goes first: both come from the same shard, which released it earlier
+    std::deque<ReconstructedBunch> merged;
+    std::merge(std::make_move_iterator(held.begin()), std::make_move_iterator(held.end()),
+               std::make_move_iterator(released.begin()), std::make_move_iterator(released.end()), std::back_inserter(merged),
+               [](const ReconstructedBunch &a, const ReconstructedBunch &b) { return a.timestamp < b.timestamp; });
+    held.swap(merged);
+}
+
+void ShardedEventBuilder::handOut(std::vector<ReconstructedBunch> &out, uint64_t below) {
+    while(!held.empty() && held.front().timestamp < below) {
+        ReconstructedBunch &bunch = held.front();
+        for(uint16_t i = 0; i < totalFEs; i++) {
+            const EventData &feData = bunch.peekEventDataFE(i);
+            heldFeBytes[i] -= feData.events.size() * sizeof(Event) + feData.nHits * sizeof(Hit);
+            heldFeHits[i] -= feData.nHits;
+        }
+        emittedBelow = std::max(emittedBelow, bunch.timestamp);
+        out.push_back(std::move(bunch));
+        held.pop_front();
+    }
+}
+
+std::size_t ShardedEventBuilder::collect(std::vector<ReconstructedBunch> &out, clock::time_point now) {
+    calibrate(now);
+    uint64_t doneBelow = completedBelow();
+
+    std::vector<std::vector<ReconstructedBunch>> parts(shards.size());
+    forEachShard([&](std::size_t i) {
+        EventBuilder &shard = *shards[i];
+        for(Item &item : inbox[i])
+            shard.insert(item.fe_id, item.key, std::move(*item.event), item.arrived);
+        inbox[i].clear();
+        shard.release(parts[i], now, doneBelow);
+    });
+    pending.clear();
+    limitWindow(parts);
+    hold(parts);
+
+    //a shard only releases its oldest bunches, so whatever is older than every bunch still open is final
+    uint64_t below = UINT64_MAX;
+    for(const auto &shard : shards)
+        below = std::min(below, shard->oldestOpen());
+
+    std::size_t before = out.size();
+    handOut(out, below);
+
+    //events for a bunch older than what went out are late, as in a single builder
+    for(auto &shard : shards)
+        shard->emittedBelow = std::max(shard->emittedBelow, emittedBelow);
+    return out.size() - before;
+}
+
+std::size_t ShardedEventBuilder::flush(std::vector<ReconstructedBunch> &out) {
+    std::vector<std::vector<ReconstructedBunch>> parts(shards.size());
+    forEachShard([&](std::size_t i) {
+        EventBuilder &shard = *shards[i];
+        for(Item &item : inbox[i])
+            shard.insert(item.fe_id, item.key, std::move(*item.event), item.arrived);
+        inbox[i].clear();
+        shard.flush(parts[i]);
+    });
+    pending.clear();
+    hold(parts);
+
+    std::size_t before = out.size();
+    handOut(out, UINT64_MAX);
+    return out.size() - before;
+}
+
+std::size_t ShardedEventBuilder::openBunches() const {
+    std::size_t n = 0;
+    for(const auto &shard : shards)
+        n += shard->openBunches();
+    return n;
+}
+
+// Events still in the inbox are not counted; they are filed by the next collect().
+// Bunches released but held back for ordering are
+std::size_t ShardedEventBuilder::heldBytes(uint16_t fe_id) const {
+    std::size_t n = heldFeBytes[fe_id];
+    for(const auto &shard : shards)
+        n += shard->heldBytes(fe_id);
+    return n;
+}
+
+std::size_t ShardedEventBuilder::heldHits(uint16_t fe_id) const {
+    std::size_t n = heldFeHits[fe_id];
+    for(const auto &shard : shards)
+        n += shard->heldHits(fe_id);
+    return n;
+}
+
+EventBuilder::Stats ShardedEventBuilder::getStats() const {
+    Stats total = stats; //calibrations
+    for(const auto &shard : shards) {
+        Stats s = shard->getStats();
+        total.bunches += s.bunches;
+        total.complete += s.complete;
+        total.timedOut += s.timedOut;
+        total.overflowed += s.overflowed;
+        total.lateEvents += s.lateEvents;
+    }
+    return total;
+}
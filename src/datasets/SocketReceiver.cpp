@@ -16,6 +16,7 @@ SocketReceiver::SocketReceiver() {
     current_retry = 0;
     max_retry_delay = 60000;
     max_connection_retries = 10;
+    poll_interval = 500;
     run_thread = false;
 }
 
@@ -23,12 +24,15 @@ SocketReceiver::~SocketReceiver() {}
 
 void SocketReceiver::run(){
     run_thread = true;
-    thread_ptr.reset(new std::thread(&SocketReceiver::process, this));
+    batch_n = 0;
+    curEvents = newBatch();
+    last = std::chrono::steady_clock::now();
+    startLoop();
 }
 
 void SocketReceiver::join() {
     run_thread = false;
-    thread_ptr->join();
+    stopLoop();
     logger->info("[{}]: Processed {} events, with {} hits, in {} batches", name, total_events, total_hits, packet_counter);
 }
 
@@ -75,53 +79,67 @@ void SocketReceiver::configure(const json &config){
     if(config.contains("max_retry_delay"))
     max_retry_delay = config["max_retry_delay"];
     else max_retry_delay = 60000;
+
+    if(config.contains("poll_interval"))
+    poll_interval = config["poll_interval"];
+    else poll_interval = 500;
 }
 
 
-void SocketReceiver::process(){
-    uint32_t batch_n = 0;
-    curEvents = std::make_unique<EventData>();
+// One packet per step. On a shared executor the socket is only read once it is
+// readable, so a quiet server never ties up a worker.
+LoopStep SocketReceiver::step(){
+    if(!run_thread)
+        return LoopStep::finished();
 
-    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now(), now;
+    if(is_connected){
+        if(usesExecutor() && !readable())
+            return LoopStep::after(std::chrono::microseconds(poll_interval));
 
-    while(run_thread) {
-        if(is_connected){
-            std::vector<uint8_t> rawbytes;
-            if(!getPacket(rawbytes)){
-                logger->debug("Failed to get {0} packet", packet_counter);
-                continue;
-            }
-            processPacket(rawbytes);
-
-            now = std::chrono::steady_clock::now();
-                if(curEvents->size() > 0) {
-                    auto diff = ((float)std::chrono::duration_cast<std::chrono::microseconds>(now - last).count())/1000000;
-                    logger->debug(
-                        "[{}] Packet {}: {} events in {} seconds = {} ev/s", 
-                        name, batch_n, curEvents->size(), diff, curEvents->size()/diff
-                    );
-                    // Push data and make new block of events
-                    output->pushData(std::move(curEvents));
-                    curEvents = std::make_unique<EventData>();
-                    batch_n++;
-                }
-            last = std::chrono::steady_clock::now();
-        }else{ //retry connection
-            if(current_retry < max_connection_retries){
-                connectToServer(false);
-                int delay = std::min(static_cast<int>(pow(2, current_retry) * 100), (int)max_retry_delay);
-                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-                current_retry++;
-
-                logger->info("{0} trying to connect to server", name);
-
-                continue;
+        std::vector<uint8_t> rawbytes;
+        if(!getPacket(rawbytes)){
+            logger->debug("Failed to get {0} packet", packet_counter);
+            return LoopStep::again();
+        }
+        processPacket(rawbytes);
+        trackBatch(*curEvents);
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if(curEvents->size() > 0) {
+                auto diff = ((float)std::chrono::duration_cast<std::chrono::microseconds>(now - last).count())/1000000;
+                logger->debug(
+                    "[{}] Packet {}: {} events in {} seconds = {} ev/s", 
+                    name, batch_n, curEvents->size(), diff, curEvents->size()/diff
+                );
+                // Push data and make new block of events
+                publishBatch(std::move(curEvents));
+                curEvents = newBatch();
+                trackBatch(*curEvents);
+                batch_n++;
             }
+        last = std::chrono::steady_clock::now();
+        return LoopStep::again();
+    }
 
-            logger->info("{0} had too many failed connections. Closing port.", name);
-            run_thread = false; //too many retries
-        }
+    //retry connection
+    if(current_retry < max_connection_retries){
+        connectToServer(false);
+        int delay = std::min(static_cast<int>(pow(2, current_retry) * 100), (int)max_retry_delay);
+        current_retry++;
+
+        logger->info("{0} trying to connect to server", name);
+
+        return LoopStep::after(std::chrono::milliseconds(delay));
     }
+
+    logger->info("{0} had too many failed connections. Closing port.", name);
+    run_thread = false; //too many retries
+    return LoopStep::finished();
+}
+
+bool SocketReceiver::readable() const{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
 }
 
 bool SocketReceiver::getPacket(std::vector<uint8_t>& buffer) const{
@@ -16,6 +16,7 @@ SocketSubscriber::SocketSubscriber()
     current_retry(0),
     max_retry_delay(60000),
     max_connection_retries(10),
+    poll_interval(500),
     run_thread(false),
     is_connected(false)
 {}
@@ -64,62 +65,83 @@ void SocketSubscriber::configure(const json &config) {
         max_retry_delay = config["max_retry_delay"];
     else
         max_retry_delay = 60000;
+
+    if (config.contains("poll_interval"))
+        poll_interval = config["poll_interval"];
+    else
+        poll_interval = 500;
 }
 
 void SocketSubscriber::run() {
     run_thread = true;
-    thread_ptr = std::make_unique<std::thread>(&SocketSubscriber::process, this);
+    batch_n = 0;
+    curEvents = newBatch();
+    last = std::chrono::steady_clock::now();
+    startLoop();
 }
 
 void SocketSubscriber::join() {
     run_thread = false;
-    thread_ptr->join();
+    stopLoop();
     logger->info("[{}]: Processed {} events, with {} hits, in {} batches",
                  name, total_events, total_hits, packet_counter);
 }
 
-void SocketSubscriber::process() {
-    uint32_t batch_n = 0;
-    curEvents = std::make_unique<EventData>();
-
-    auto last = std::chrono::steady_clock::now();
-    std::chrono::steady_clock::time_point now;
-
-    while (run_thread) {
-        if (is_connected) {
-            std::vector<uint8_t> rawbytes;
-            if (!getPacket(rawbytes)) {
-                logger->debug("Failed to get {} packet", packet_counter);
-                continue;
-            }
-            processPacket(rawbytes);
-
-            now = std::chrono::steady_clock::now();
-            if (curEvents->size() > 0) {
-                float diff = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count() / 1e6f;
-                logger->info(
-                    "[{}] Batch {}: {} events in {} seconds = {} ev/s TotalEvents: {}",
-                    name, batch_n, curEvents->size(), diff, curEvents->size() / diff, total_events
-                );
-                output->pushData(std::move(curEvents));
-                curEvents = std::make_unique<EventData>();
-                batch_n++;
-                packet_counter++;
-            }
-            last = std::chrono::steady_clock::now();
-        } else {
-            if (current_retry < max_connection_retries) {
-                connectToServer(false);
-                int delay = std::min(static_cast<int>(std::pow(2, current_retry) * 100),
-                                     static_cast<int>(max_retry_delay));
-                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-                current_retry++;
-                logger->info("{} trying to connect to server", name);
-                continue;
-            }
-            logger->info("{} had too many failed connections. Stopping.", name);
-            run_thread = false;
+// One message per step; on a shared executor recv is only called once a message is waiting
+LoopStep SocketSubscriber::step() {
+    if (!run_thread)
+        return LoopStep::finished();
+
+    if (is_connected) {
+        if (usesExecutor() && !readable())
+            return LoopStep::after(std::chrono::microseconds(poll_interval));
+
+        std::vector<uint8_t> rawbytes;
+        if (!getPacket(rawbytes)) {
+            logger->debug("Failed to get {} packet", packet_counter);
+            return LoopStep::again();
         }
+        processPacket(rawbytes);
+        trackBatch(*curEvents);
+
+        auto now = std::chrono::steady_clock::now();
+        if (curEvents->size() > 0) {
+            float diff = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count() / 1e6f;
+            logger->info(
+                "[{}] Batch {}: {} events in {} seconds = {} ev/s TotalEvents: {}",
+                name, batch_n, curEvents->size(), diff, curEvents->size() / diff, total_events
+            );
+            publishBatch(std::move(curEvents));
+            curEvents = newBatch();
+            trackBatch(*curEvents);
+            batch_n++;
+            packet_counter++;
+        }
+        last = std::chrono::steady_clock::now();
+        return LoopStep::again();
+    }
+
+    if (current_retry < max_connection_retries) {
+        connectToServer(false);
+        int delay = std::min(static_cast<int>(std::pow(2, current_retry) * 100),
+                             static_cast<int>(max_retry_delay));
+        current_retry++;
+        logger->info("{} trying to connect to server", name);
+        return LoopStep::after(std::chrono::milliseconds(delay));
+    }
+    logger->info("{} had too many failed connections. Stopping.", name);
+    run_thread = false;
+    return LoopStep::finished();
+}
+
+bool SocketSubscriber::readable() const {
+    zmq::pollitem_t item = {static_cast<void*>(*subscriber), 0, ZMQ_POLLIN, 0};
+    try {
+        return zmq::poll(&item, 1, std::chrono::milliseconds(0)) > 0;
+    }
+    catch (const zmq::error_t &e) {
+        logger->debug("Error polling socket: {}", e.what());
+        return false;
     }
 }
 
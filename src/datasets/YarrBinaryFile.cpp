@@ -28,12 +28,14 @@ YarrBinaryFile::~YarrBinaryFile() {}
 
 void YarrBinaryFile::run() {
     run_thread = true;
-    thread_ptr.reset(new std::thread(&YarrBinaryFile::process, this));
+    batch_n = 0;
+    curEvents = newBatch();
+    startLoop();
 }
 
 void YarrBinaryFile::join() {
     run_thread = false;
-    thread_ptr->join();
+    stopLoop();
     logger->info("[{}]: Processed {} events, with {} hits, in {} batches", name, total_events, total_hits, batch_n);
 }
 
@@ -95,40 +97,36 @@ void YarrBinaryFile::processBatch() {
     while(fileHandle && run_thread && (curEvents != nullptr) && read_success) { // basic case of "block lives"
         // logger->debug("[{}]: batch variables: fh {} rt {} np {} rs {}", name, (bool)fileHandle, (bool)run_thread, (bool)(curEvents != nullptr), (bool)read_success);
         read_success = fromFile();
+        trackBatch(*curEvents);
         // logger->debug("[{}]: batch after variables: rm {} fh {} rt {} np {} rs {}", name, file_rm, (bool)fileHandle, (bool)run_thread, (bool)(curEvents != nullptr), (bool)read_success);
         if(curEvents->size() == max_events_per_block)
             break;
     }
 }
 
-void YarrBinaryFile::process() {
-    // signaled = 0;
-    // signal(SIGINT, [](int signum){signaled = 1;});
-    // signal(SIGUSR1, [](int signum){signaled = 1;});
-
-    batch_n = 0;
-    curEvents = std::make_unique<EventData>();
+// One block: read until EOF or max_events_per_block, push, then rest for block_timeout
+LoopStep YarrBinaryFile::step() {
+    if(!run_thread)
+        return LoopStep::finished();
 
     std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now(), now;
 
-    while(run_thread) {
-        processBatch();
-        now = std::chrono::steady_clock::now();
-        if(curEvents->size() > 0) {
-            auto diff = ((float)std::chrono::duration_cast<std::chrono::microseconds>(now - last).count())/1000000;
-            logger->debug(
-                "[{}] Batch {}: {} events in {} seconds = {} ev/s", 
-                name, batch_n, curEvents->size(), diff, curEvents->size()/diff
-            );
-            // Push data and make new block of events
-            output->pushData(std::move(curEvents));
-            curEvents = std::make_unique<EventData>();
-
-            batch_n++;
-        }
-        std::this_thread::sleep_for(std::chrono::microseconds(block_timeout));
-        last = std::chrono::steady_clock::now();
+    processBatch();
+    now = std::chrono::steady_clock::now();
+    if(curEvents->size() > 0) {
+        auto diff = ((float)std::chrono::duration_cast<std::chrono::microseconds>(now - last).count())/1000000;
+        logger->debug(
+            "[{}] Batch {}: {} events in {} seconds = {} ev/s", 
+            name, batch_n, curEvents->size(), diff, curEvents->size()/diff
+        );
+        // Push data and make new block of events
+        publishBatch(std::move(curEvents));
+        curEvents = newBatch();
+        trackBatch(*curEvents);
+
+        batch_n++;
     }
+    return LoopStep::after(std::chrono::microseconds(block_timeout));
 }
 
 void YarrBinaryFile::readHeader() {
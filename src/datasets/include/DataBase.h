@@ -9,11 +9,18 @@
 // #################################################
 
 #include "ClipBoard.h"
+#include "Executor.h"
+#include "Affinity.h"
 #include "util.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <thread>
 #include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include <csignal>
 
 struct Hit {
@@ -24,19 +31,32 @@ struct Hit {
 
 class Event {
     public:
-        Event() {
+        using allocator_type = std::pmr::polymorphic_allocator<Hit>;
+
+        explicit Event(const allocator_type& alloc = {}) : hits(alloc) {
             tag = 0;
             l1id = 0;
             bcid = 0;
             nHits = 0;
         }
-        Event(unsigned arg_tag, unsigned arg_l1id, unsigned arg_bcid) {
+        Event(unsigned arg_tag, unsigned arg_l1id, unsigned arg_bcid, const allocator_type& alloc = {}) : hits(alloc) {
             tag = arg_tag;
             l1id = arg_l1id;
             bcid = arg_bcid;
             nHits = 0;
         }
 
+        //Allocator-extended copy/move so events can be placed in a batch arena by pmr containers
+        Event(const Event& other) = default;
+        Event(Event&& other) = default;
+        Event(const Event& other, const allocator_type& alloc)
+            : l1id(other.l1id), bcid(other.bcid), tag(other.tag), nHits(other.nHits), timestamp(other.timestamp), hits(other.hits, alloc) {}
+        Event(Event&& other, const allocator_type& alloc)
+            : l1id(other.l1id), bcid(other.bcid), tag(other.tag), nHits(other.nHits), timestamp(other.timestamp), hits(std::move(other.hits), alloc) {}
+
+        Event& operator=(const Event& other) = default;
+        Event& operator=(Event&& other) = default;
+
         void addHit(Hit hit) {
             hits.push_back(hit);
             nHits++;
@@ -49,16 +69,71 @@ class Event {
 
         uint32_t l1id, bcid, tag;
         uint16_t nHits = 0;
-        std::vector<Hit> hits;
+        uint64_t timestamp = 0; //unwrapped bcid of the FE, never decreasing; 0 until stamped by an EventTimeline
+        std::pmr::vector<Hit> hits;
 };
 
 class EventData {
     public:
-        EventData() = default;
+        using allocator_type = std::pmr::polymorphic_allocator<Event>;
+
+        explicit EventData(const allocator_type& alloc = {}) : bcidChangeIndex(alloc), events(alloc) {}
+
+        //Batch that owns a monotonic arena: every event and hit of the batch is carved out of it
+        //and the whole block is released in one step when the EventData is destroyed. arenaSize is
+        //the initial size the arena was created with, for footprint()
+        EventData(std::unique_ptr<std::pmr::monotonic_buffer_resource> batchArena, std::size_t arenaSize)
+            : arena(std::move(batchArena)), arenaBytes(arenaSize), bcidChangeIndex(arena.get()), events(arena.get()) {}
+
+        EventData(const EventData& other) : EventData(other, allocator_type()) {}
+        EventData(const EventData& other, const allocator_type& alloc)
+            : bcidChanged(other.bcidChanged), bcidChangeIndex(other.bcidChangeIndex, alloc), events(other.events, alloc), nHits(other.nHits) {
+            curEvent = events.empty() ? nullptr : &events.back();
+        }
+
+        //The arena travels with the containers it backs
+        EventData(EventData&& other) noexcept
+            : arena(std::move(other.arena)), arenaBytes(other.arenaBytes), bcidChanged(other.bcidChanged), bcidChangeIndex(std::move(other.bcidChangeIndex)),
+              curEvent(other.curEvent), events(std::move(other.events)), nHits(other.nHits) {
+            other.curEvent = nullptr;
+            other.nHits = 0;
+            other.arenaBytes = 0;
+        }
+        EventData(EventData&& other, const allocator_type& alloc)
+            : bcidChanged(other.bcidChanged), bcidChangeIndex(std::move(other.bcidChangeIndex), alloc), events(std::move(other.events), alloc), nHits(other.nHits) {
+            curEvent = events.empty() ? nullptr : &events.back();
+            other.curEvent = nullptr;
+            other.nHits = 0;
+        }
+
+        //Assignment keeps this object's memory resource; elements are moved or copied into it
+        EventData& operator=(const EventData& other) {
+            if(this == &other)
+                return *this;
+            bcidChanged = other.bcidChanged;
+            bcidChangeIndex.assign(other.bcidChangeIndex.begin(), other.bcidChangeIndex.end());
+            events.assign(other.events.begin(), other.events.end());
+            curEvent = events.empty() ? nullptr : &events.back();
+            nHits = other.nHits;
+            return *this;
+        }
+        EventData& operator=(EventData&& other) {
+            if(this == &other)
+                return *this;
+            bcidChanged = other.bcidChanged;
+            bcidChangeIndex = std::move(other.bcidChangeIndex);
+            events = std::move(other.events);
+            curEvent = events.empty() ? nullptr : &events.back();
+            nHits = other.nHits;
+            other.curEvent = nullptr;
+            other.nHits = 0;
+            return *this;
+        }
+
         ~EventData() = default;
 
         void newEvent(unsigned arg_tag, unsigned arg_l1id, unsigned arg_bcid) {
-            events.emplace_back(Event(arg_tag, arg_l1id, arg_bcid));
+            events.emplace_back(arg_tag, arg_l1id, arg_bcid);
             curEvent = &events.back();
         }
 
@@ -67,17 +142,40 @@ class EventData {
             curEvent = &events.back();
             nHits += newEvent.nHits;
         }
+
+        void addEvent(Event&& newEvent){
+            nHits += newEvent.nHits;
+            events.push_back(std::move(newEvent));
+            curEvent = &events.back();
+        }
         
         void addEventData(const EventData& newEventData){
+            if(newEventData.empty())
+                return;
+            appendChangeIndex(newEventData);
             events.insert(events.end(), newEventData.events.begin(), newEventData.events.end());
             curEvent = &events.back();
             nHits += newEventData.nHits;
         }
 
+        //Moves the events over; hit storage is stolen when both batches share a memory resource
+        void addEventData(EventData&& newEventData){
+            if(newEventData.empty())
+                return;
+            appendChangeIndex(newEventData);
+            events.insert(events.end(), std::make_move_iterator(newEventData.events.begin()), std::make_move_iterator(newEventData.events.end()));
+            curEvent = &events.back();
+            nHits += newEventData.nHits;
+            newEventData.events.clear();
+            newEventData.bcidChangeIndex.clear();
+            newEventData.curEvent = nullptr;
+            newEventData.nHits = 0;
+        }
+
         void delete_back() {
             nHits -= events.back().nHits;
             events.pop_back();
-            curEvent = &events.back();
+            curEvent = events.empty() ? nullptr : &events.back();
         }
 
         void addHit(Hit hit) {
@@ -98,28 +196,69 @@ class EventData {
             return events.size();
         }
 
+        bool hasArena() const { return arena != nullptr; }
+
+        //Approximate heap footprint of the batch in O(1), assuming hit storage is tightly packed.
+        //An arena holds at least the size it was created with, however little of it is used
+        std::size_t footprint() const {
+            std::size_t contents = events.capacity() * sizeof(Event) + nHits * sizeof(Hit) + bcidChangeIndex.capacity() * sizeof(size_t);
+            return sizeof(EventData) + std::max(contents, arenaBytes);
+        }
+
+    private:
+        void appendChangeIndex(const EventData& newEventData){
+            size_t offset = events.size();
+            for(size_t index : newEventData.bcidChangeIndex)
+                bcidChangeIndex.push_back(offset + index);
+            bcidChanged = bcidChanged || newEventData.bcidChanged;
+        }
+
+        //Declared first so it outlives the containers allocated from it
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+        std::size_t arenaBytes = 0;
+
+    public:
         bool bcidChanged = false;
-        std::vector<size_t> bcidChangeIndex; //Index of event with different bcid compared to previous event
+        std::pmr::vector<size_t> bcidChangeIndex; //Index of event with different bcid compared to previous event
         
-        Event* curEvent;
-        std::vector<Event> events;
-        uint16_t nHits = 0;
+        Event* curEvent = nullptr;
+        std::pmr::vector<Event> events;
+        uint32_t nHits = 0;
+};
+
+template <>
+struct ClipBoardFootprint<EventData> {
+    static std::size_t bytes(const EventData &data) { return data.footprint(); }
+    static std::size_t hits(const EventData &data) { return data.nHits; }
 };
 
 class ReconstructedBunch{
     public:
-        ReconstructedBunch(){
+        using allocator_type = std::pmr::polymorphic_allocator<EventData>;
+
+        explicit ReconstructedBunch(const allocator_type& alloc = {}) : fe_events(alloc) {
             bcid = 0;
             totalFEs = 0;
             nHits = 0;
         }
-        ReconstructedBunch(uint32_t arg_bcid, size_t arg_totalFEs) {
+        ReconstructedBunch(uint32_t arg_bcid, size_t arg_totalFEs, const allocator_type& alloc = {}) : fe_events(alloc) {
             bcid = arg_bcid;
             totalFEs = arg_totalFEs;
             nHits = 0;
 
             fe_events.resize(arg_totalFEs);
         }
+
+        ReconstructedBunch(const ReconstructedBunch& other) = default;
+        ReconstructedBunch(ReconstructedBunch&& other) = default;
+        ReconstructedBunch(const ReconstructedBunch& other, const allocator_type& alloc)
+            : totalFEs(other.totalFEs), nHits(other.nHits), bcid(other.bcid), timestamp(other.timestamp), fe_events(other.fe_events, alloc) {}
+        ReconstructedBunch(ReconstructedBunch&& other, const allocator_type& alloc)
+            : totalFEs(other.totalFEs), nHits(other.nHits), bcid(other.bcid), timestamp(other.timestamp), fe_events(std::move(other.fe_events), alloc) {}
+
+        ReconstructedBunch& operator=(const ReconstructedBunch& other) = default;
+        ReconstructedBunch& operator=(ReconstructedBunch&& other) = default;
+
         void addEvent(const Event& newEvent, uint16_t fe_id){
             if(this->bcid != newEvent.bcid || fe_id > totalFEs)
                 return;
@@ -128,6 +267,15 @@ class ReconstructedBunch{
             fe_events[fe_id].addEvent(newEvent);
         }
 
+        //For builders that already matched the event to this bunch (its raw bcid may differ, e.g. across a wrap)
+        void addMatchedEvent(Event&& newEvent, uint16_t fe_id){
+            if(fe_id >= totalFEs)
+                return;
+
+            nHits += newEvent.nHits;
+            fe_events[fe_id].addEvent(std::move(newEvent));
+        }
+
         void addEventData(const EventData& newEventData, uint16_t fe_id){
             for(int i = 0; i < newEventData.events.size(); i++){
                 if(newEventData.events[i].bcid == bcid){
@@ -139,7 +287,7 @@ class ReconstructedBunch{
     
         //Adds EventData using the bcidChangeIndex (Assumes that the bcidChangeIndex indexes events correctly)
         void addEventDataCI(const EventData& newEventData, uint16_t fe_id){
-            std::vector<size_t> bcidChangeIndex = newEventData.bcidChangeIndex;
+            const std::pmr::vector<size_t>& bcidChangeIndex = newEventData.bcidChangeIndex;
             if(bcidChangeIndex.size()!=0){
                 for(int i = 0; i < bcidChangeIndex.size(); i++){
                     if(newEventData.events[bcidChangeIndex[i]].bcid == bcid){
@@ -164,19 +312,123 @@ class ReconstructedBunch{
             }
         }
         //Gives the memory to user
-        std::unique_ptr<std::vector<EventData>> getEventData(){
-            return std::make_unique<std::vector<EventData>>(std::move(fe_events));
+        std::unique_ptr<std::pmr::vector<EventData>> getEventData(){
+            return std::make_unique<std::pmr::vector<EventData>>(std::move(fe_events));
         }
         std::unique_ptr<EventData> getEventDataFE(uint16_t fe_id){
             return std::make_unique<EventData>(std::move(fe_events[fe_id]));
         }
+        const EventData& peekEventDataFE(uint16_t fe_id) const{
+            return fe_events[fe_id];
+        }
         uint16_t totalFEs;
         uint32_t nHits, bcid;
+        uint64_t timestamp = 0; //unwrapped bcid set by the EventBuilder, keeps increasing across bcid wraps
+    private:
+        std::pmr::vector<EventData> fe_events; //Event with associated fe_id. ie, access events of fe with id fe_id fe_events[fe_id]
+};
+
+
+//Per-FE unwrapping of the 16-bit bcid and l1id counters into one monotonic 64-bit timestamp,
+//counted in bunch crossings. A step of the bcid by less than half a period either way is
+//followed across a wrap; near half a period the l1id decides whether the counter moved on.
+//When batches arrive further apart than one bcid period several wraps may have gone unseen:
+//these gaps are counted, and with "timeline_resync" the timestamp is moved on by the number
+//of whole periods the arrival time accounts for (for live sources; file replays are not real time).
+//Events never move backwards: a step back is counted and the event keeps the newest timestamp.
+struct TimelineStats {
+    std::size_t events = 0;
+    std::size_t bcidWraps = 0, l1idWraps = 0;
+    std::size_t backsteps = 0; //bcid stepped back, timestamp held
+    std::size_t gaps = 0;      //batches arriving more than a bcid period after the previous one
+    std::size_t resyncs = 0;   //gaps that moved the timestamp on ("timeline_resync")
+};
+
+class EventTimeline {
+    public:
+        static constexpr unsigned bcidBits = 16;
+        static constexpr unsigned l1idBits = 16;
+
+        void configure(const json &config) {
+            if(config.contains("timeline_resync"))
+                resync = (bool)config["timeline_resync"];
+            if(config.contains("bcid_period_ns"))
+                crossing = std::chrono::nanoseconds((long)config["bcid_period_ns"]);
+        }
+
+        //Stamps every event of a batch that arrived at the given time
+        void stamp(EventData &batch, std::chrono::steady_clock::time_point arrival) {
+            constexpr uint64_t period = uint64_t(1) << bcidBits;
+
+            if(started && !batch.empty()) {
+                auto elapsed = arrival - lastArrival;
+                if(elapsed > crossing * period) {
+                    stats.gaps++;
+                    uint64_t periods = elapsed / (crossing * period);
+                    if(resync && periods > 0) {
+                        last += periods * period;
+                        stats.resyncs++;
+                    }
+                }
+            }
+            if(!batch.empty())
+                lastArrival = arrival;
+
+            for(Event &event : batch.events) {
+                if(!started) {
+                    last = period + event.bcid; //one period in, so stepping back never underflows
+                    lastL1id = event.l1id;
+                    started = true;
+                }
+                else {
+                    uint64_t delta = (event.bcid - last) & (period - 1);
+                    uint32_t l1Step = (event.l1id - lastL1id) & ((uint32_t(1) << l1idBits) - 1);
+                    bool l1Forward = l1Step != 0 && l1Step < (uint32_t(1) << (l1idBits - 1));
+                    if(event.l1id < lastL1id && l1Forward)
+                        stats.l1idWraps++;
+                    lastL1id = event.l1id;
+
+                    bool forward = delta < period / 2;
+                    if(delta > period / 4 && delta < 3 * period / 4) //too close to call on the bcid alone
+                        forward = l1Forward;
+
+                    if(forward && delta != 0) {
+                        if((last & (period - 1)) + delta >= period)
+                            stats.bcidWraps++;
+                        last += delta;
+                    }
+                    else if(!forward) {
+                        stats.backsteps++;
+                    }
+                }
+                event.timestamp = last;
+                stats.events++;
+            }
+        }
+
+        const TimelineStats& getStats() const { return stats; }
+
     private:
-        std::vector<EventData> fe_events; //Event with associated fe_id. ie, access events of fe with id fe_id fe_events[fe_id]
+        bool started = false;
+        bool resync = false;
+        std::chrono::nanoseconds crossing{25}; //LHC bunch spacing
+        uint64_t last = 0;
+        uint32_t lastL1id = 0;
+        std::chrono::steady_clock::time_point lastArrival;
+        TimelineStats stats;
 };
 
 
+//Returned by DataLoader::step(): when the next step should run
+struct LoopStep {
+    bool done = false;
+    std::chrono::microseconds delay{0};
+
+    static LoopStep again() { return {}; }
+    static LoopStep after(std::chrono::microseconds d) { return {false, d}; }
+    static LoopStep finished() { return {true, std::chrono::microseconds(0)}; }
+};
+
 class DataLoader{
     public:
         DataLoader() = default;
@@ -189,9 +441,175 @@ class DataLoader{
         virtual void run() = 0;
         virtual void join() = 0;
 
+        //Per-source batch memory. With "batch_arena" enabled every pushed EventData owns a
+        //monotonic arena of "batch_arena_size" bytes (grown on demand) released in one step by the consumer
+        void configureBatches(const json &arg_config) {
+            if(arg_config.contains("batch_arena"))
+                batch_arena = (bool)arg_config["batch_arena"];
+            if(arg_config.contains("batch_arena_size"))
+                batch_arena_size = (std::size_t)arg_config["batch_arena_size"];
+        }
+
+        //Run on a shared executor instead of a dedicated thread. Must be set before run()
+        void setExecutor(std::shared_ptr<Executor> arg_executor) {
+            executor = arg_executor;
+        }
+        bool usesExecutor() const { return (bool)executor; }
+
+        //CPUs/NUMA node for the loader's own thread and node for its batch arenas.
+        //On a shared executor the pool workers are pinned instead.
+        void setPlacement(const affinity::Placement &arg_placement) {
+            placement = arg_placement;
+        }
+        const affinity::Placement& getPlacement() const { return placement; }
+
+        //Timestamping of the events pushed by this loader, see EventTimeline
+        void configureTimeline(const json &arg_config) {
+            timeline.configure(arg_config);
+        }
+        const TimelineStats& getTimelineStats() const { return timeline.getStats(); } //only stable once the loader is joined
+
+        //Bytes and hits held by the batch this loader is currently filling and one waiting for room in the clipboard
+        std::size_t pendingBytes() const { return pending_bytes + blocked_bytes; }
+        std::size_t pendingHits() const { return pending_hits + blocked_hits; }
+
     protected:
+        //One bounded unit of work (read the next chunk, service the socket once).
+        //Loaders that drive themselves through startLoop() override this.
+        virtual LoopStep step() { return LoopStep::finished(); }
+
+        //Calls step() until it finishes or stopLoop() is called: as a chain of tasks
+        //on the executor if one is set, otherwise on a dedicated thread
+        void startLoop() {
+            loop_run = true;
+            if(executor) {
+                {
+                    std::lock_guard<std::mutex> lock(loop_mutex);
+                    loop_pending = true;
+                }
+                executor->submit([this]() { loopTask(); });
+                return;
+            }
+            thread_ptr.reset(new std::thread([this]() {
+                if(placement.any())
+                    affinity::pinCurrentThread(placement);
+                while(loop_run) {
+                    LoopStep next = nextStep();
+                    if(next.done)
+                        break;
+                    if(next.delay.count() > 0)
+                        std::this_thread::sleep_for(next.delay);
+                }
+                dropBlocked();
+            }));
+        }
+
+        //Returns once no step is running or scheduled any more
+        void stopLoop() {
+            loop_run = false;
+            if(executor) {
+                executor->wakeDelayed(this);
+                std::unique_lock<std::mutex> lock(loop_mutex);
+                loop_cv.wait(lock, [this]() { return !loop_pending; });
+            }
+            else if(thread_ptr && thread_ptr->joinable()) {
+                thread_ptr->join();
+            }
+        }
+
+        //Called by the loader thread whenever the batch under construction changes noticeably
+        void trackBatch(const EventData &batch) {
+            pending_bytes.store(batch.footprint(), std::memory_order_relaxed);
+            pending_hits.store(batch.nHits, std::memory_order_relaxed);
+        }
+
+        //Stamps the events of a finished batch and hands it to the consumer. If the clipboard is
+        //full the batch is held back and no further step() runs until it went through
+        void publishBatch(std::unique_ptr<EventData> batch) {
+            timeline.stamp(*batch, std::chrono::steady_clock::now());
+            if(output->tryPushData(batch))
+                return;
+            blocked_bytes.store(batch->footprint(), std::memory_order_relaxed);
+            blocked_hits.store(batch->nHits, std::memory_order_relaxed);
+            blocked_batch = std::move(batch);
+        }
+
+        std::unique_ptr<EventData> newBatch() const {
+            if(batch_arena)
+                return std::make_unique<EventData>(std::make_unique<std::pmr::monotonic_buffer_resource>(batch_arena_size, affinity::nodeResource(placement.node)), batch_arena_size);
+            return std::make_unique<EventData>();
+        }
+
         std::shared_ptr<ClipBoard<EventData>> output;
         std::unique_ptr<std::thread> thread_ptr;
+
+        bool batch_arena = false;
+        std::size_t batch_arena_size = 1 << 20;
+
+        std::atomic<std::size_t> pending_bytes{0}, pending_hits{0};
+
+    private:
+        EventTimeline timeline;
+
+        //A full clipboard is retried with a backoff of up to maxBlockedDelay instead of
+        //blocking, so a slow consumer never parks a worker of a shared executor
+        static constexpr std::chrono::microseconds minBlockedDelay{20}, maxBlockedDelay{1000};
+
+        LoopStep nextStep() {
+            if(blocked_batch) {
+                if(!output->tryPushData(blocked_batch)) {
+                    blocked_delay = std::min(blocked_delay * 2, maxBlockedDelay);
+                    return LoopStep::after(blocked_delay);
+                }
+                blocked_batch.reset();
+                blocked_bytes.store(0, std::memory_order_relaxed);
+                blocked_hits.store(0, std::memory_order_relaxed);
+            }
+            blocked_delay = minBlockedDelay / 2;
+            LoopStep next = step();
+            if(next.done && blocked_batch) // the last batch still has to go through
+                return LoopStep::after(minBlockedDelay);
+            return next;
+        }
+
+        //Once the loop stopped, a batch still waiting for room is given one last try
+        void dropBlocked() {
+            if(blocked_batch && !output->tryPushData(blocked_batch))
+                output->dropData(std::move(blocked_batch));
+            blocked_batch.reset();
+            blocked_bytes.store(0, std::memory_order_relaxed);
+            blocked_hits.store(0, std::memory_order_relaxed);
+        }
+
+        void loopTask() {
+            LoopStep next = loop_run ? nextStep() : LoopStep::finished();
+            if(loop_run && !next.done) {
+                if(next.delay.count() > 0) {
+                    executor->submitAfter(next.delay, [this]() { loopTask(); }, this);
+                    if(!loop_run) // stopLoop() may have woken the timers just before we armed ours
+                        executor->wakeDelayed(this);
+                }
+                else {
+                    executor->submit([this]() { loopTask(); });
+                }
+                return;
+            }
+            dropBlocked();
+            std::lock_guard<std::mutex> lock(loop_mutex);
+            loop_pending = false;
+            loop_cv.notify_all();
+        }
+
+        std::shared_ptr<Executor> executor;
+        affinity::Placement placement;
+        std::atomic<bool> loop_run{false};
+        std::mutex loop_mutex;
+        std::condition_variable loop_cv;
+        bool loop_pending = false;
+
+        std::unique_ptr<EventData> blocked_batch; //published while the clipboard was full
+        std::atomic<std::size_t> blocked_bytes{0}, blocked_hits{0};
+        std::chrono::microseconds blocked_delay = minBlockedDelay / 2;
 };
 
 
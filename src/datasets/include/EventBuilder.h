@@ -0,0 +1,175 @@
+#ifndef EVENTBUILDER_H
+#define EVENTBUILDER_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Streaming event builder merging the FE streams into bunches
+// # Comment: Work is proportional to the events seen, not to the bcid span
+// #################################################
+
+#include "DataBase.h"
+#include "CircularBuffer.h"
+#include "util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Identifies the bunch an event belongs to. time is the unwrapped bcid in the
+// frame of the reference FE; l1id and tag are only used by composite matching.
+struct BunchKey {
+    uint64_t time = 0;
+    uint32_t l1id = 0, tag = 0;
+
+    bool operator==(const BunchKey &o) const { return time == o.time && l1id == o.l1id && tag == o.tag; }
+    bool operator<(const BunchKey &o) const {
+        if(time != o.time)
+            return time < o.time;
+        return l1id != o.l1id ? l1id < o.l1id : tag < o.tag;
+    }
+    bool operator>(const BunchKey &o) const { return o < *this; }
+};
+
+struct BunchKeyHash {
+    std::size_t operator()(const BunchKey &k) const {
+        return std::hash<uint64_t>()(k.time * 0x9E3779B97F4A7C15ull ^ ((uint64_t(k.l1id) << 32) | k.tag));
+    }
+};
+
+// Merges the event streams of all FEs into ReconstructedBunches. Only bunches
+// that actually received events exist; they are held in a hash map until either
+// every FE has moved past them or they have been open for longer than the
+// timeout, and are then handed out oldest first. Feed and collect from one thread.
+//
+// Matching "bcid" puts events with the same unwrapped bcid together. Matching
+// "composite" uses (tag, l1id, bcid) with per-FE bcid and l1id offsets, which a
+// background thread learns from the cross-correlation of the hit times of each
+// FE with those of the reference FE (the first one with enough hits).
+class EventBuilder {
+        friend class ShardedEventBuilder;
+
+    public:
+        using clock = std::chrono::steady_clock;
+
+        enum class Matching { Bcid, Composite };
+
+        struct Stats {
+            std::size_t bunches = 0;      //bunches handed out
+            std::size_t complete = 0;     //...because every FE had moved past them
+            std::size_t timedOut = 0;     //...because their timeout expired
+            std::size_t overflowed = 0;   //...because the window was full
+            std::size_t lateEvents = 0;   //events arriving for a bunch that had already been handed out
+            std::size_t calibrations = 0; //offset estimates applied
+        };
+
+        explicit EventBuilder(std::size_t arg_totalFEs);
+        virtual ~EventBuilder();
+
+        EventBuilder(const EventBuilder &o) = delete;
+        EventBuilder& operator=(const EventBuilder &o) = delete;
+
+        // viz_config.event_builder: {"timeout": ms, "window": max. open bunches, "match": "bcid" or "composite",
+        //  "calibration": {"interval": ms, "samples": hit times kept per FE, "max_offset": bcids, "min_pairs": n}}
+        virtual void configure(const json &config);
+
+        // Consumes one block of fe; its events are moved into the open bunches
+        virtual void add(uint16_t fe_id, EventData &&block, clock::time_point now = clock::now());
+
+        // Appends the bunches that are ready to out, oldest first. Returns how many
+        virtual std::size_t collect(std::vector<ReconstructedBunch> &out, clock::time_point now = clock::now());
+
+        // Hands out every open bunch regardless of completeness, e.g. when stopping
+        virtual std::size_t flush(std::vector<ReconstructedBunch> &out);
+
+        virtual std::size_t openBunches() const { return open.size(); }
+        virtual std::size_t heldBytes(uint16_t fe_id) const { return fes[fe_id].bytes; }
+        virtual std::size_t heldHits(uint16_t fe_id) const { return fes[fe_id].hits; }
+        virtual Stats getStats() const { return stats; }
+        Matching getMatching() const { return matching; }
+
+        // Offsets subtracted from the FE's counters to get the reference frame (0 for bcid matching)
+        int64_t getBcidOffset(uint16_t fe_id) const { return fes[fe_id].bcidOffset; }
+        uint32_t getL1idOffset(uint16_t fe_id) const { return fes[fe_id].l1idOffset; }
+
+        // Width of the bcid and l1id fields on the wire
+        static constexpr unsigned bcidBits = 16;
+        static constexpr unsigned l1idBits = 16;
+
+    private:
+        struct OpenBunch {
+            ReconstructedBunch bunch;
+            clock::time_point firstSeen;
+        };
+
+        struct FeState {
+            bool seen = false;
+            uint64_t last = 0;      //unwrapped bcid of the newest event
+            uint64_t shift = 0;     //from the FE's EventTimeline timestamps to the shared epoch
+            int64_t bcidOffset = 0;
+            uint32_t l1idOffset = 0;
+            std::size_t bytes = 0, hits = 0;
+        };
+
+        // Estimated offsets of each FE relative to the reference FE, found[i] false if unknown
+        struct Offsets {
+            std::vector<bool> found;
+            std::vector<int64_t> bcid;
+            std::vector<uint32_t> l1id;
+        };
+
+        // The two halves of add(): find the bunch an event belongs to, then put it there
+        BunchKey keyOf(uint16_t fe_id, const Event &event);
+        void insert(uint16_t fe_id, const BunchKey &key, Event &&event, clock::time_point now);
+
+        // The two halves of collect(): update offsets, then hand out what is ready
+        void calibrate(clock::time_point now);
+        std::size_t release(std::vector<ReconstructedBunch> &out, clock::time_point now, uint64_t doneBelow);
+
+        uint64_t unwrap(FeState &fe, uint32_t bcid);
+        uint64_t align(FeState &fe, const Event &event);
+        uint64_t completedBelow() const; //every FE has moved past bunches with time below this
+        uint64_t oldestOpen() const { return order.empty() ? UINT64_MAX : order.top().time; }
+        void emit(const BunchKey &key, std::vector<ReconstructedBunch> &out);
+
+        void startCalibration(clock::time_point now);
+        void applyCalibration();
+        void calibrationLoop();
+        Offsets estimateOffsets(const std::vector<std::vector<std::pair<uint64_t, uint32_t>>> &hitTimes) const;
+
+        std::size_t totalFEs;
+        std::chrono::microseconds timeout{std::chrono::milliseconds(100)};
+        std::size_t window = 4096;
+        Matching matching = Matching::Bcid;
+
+        std::vector<FeState> fes;
+        std::unordered_map<BunchKey, OpenBunch, BunchKeyHash> open;
+        std::priority_queue<BunchKey, std::vector<BunchKey>, std::greater<BunchKey>> order; //keys of open, oldest first
+        uint64_t newest = 0;       //largest unwrapped bcid seen from any FE
+        uint64_t emittedBelow = 0; //time of the newest bunch handed out
+        OpenBunch *lastBunch = nullptr; //events of one bunch come in runs; skips the lookup within a run
+        BunchKey lastKey;
+        Stats stats;
+
+        // Calibration: hit times (unwrapped bcid -> l1id) of every FE, handed to the calibration thread
+        std::vector<viz::CircularBuffer<uint32_t>> hitTimes;
+        std::chrono::milliseconds calInterval{1000};
+        std::size_t calSamples = 4096, calMinPairs = 20;
+        int64_t calMaxOffset = 256;
+        clock::time_point nextCalibration;
+
+        std::thread calThread;
+        std::mutex calMutex;
+        std::condition_variable calCv;
+        bool calStop = false, calBusy = false;
+        std::vector<std::vector<std::pair<uint64_t, uint32_t>>> calInput;
+        Offsets calResult;
+        std::atomic<bool> calReady{false};
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SHARDEDEVENTBUILDER_H
+#define SHARDEDEVENTBUILDER_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Event builder spreading the bunches over worker threads
+// # Comment: Selected by viz_config.event_builder.threads > 1
+// #################################################
+
+#include "EventBuilder.h"
+#include "Executor.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Shards the bunch space by time modulo the number of shards; each shard is an
+// EventBuilder of its own that only ever sees its bunches. The caller's thread
+// does the cheap part (unwrapping, offsets, picking the shard) in add(); collect()
+// lets every shard file its events and release its ready bunches in parallel on
+// a private pool, then merges the per-shard outputs back into one ordered list.
+// A shard may release a bunch (timed out, say) newer than one still open in
+// another shard, so released bunches are held back until no shard has an older
+// one open; the output is then ordered like that of a single EventBuilder. The
+// window applies to the open bunches of all shards together.
+// As with EventBuilder, add and collect must be called from one thread.
+class ShardedEventBuilder : public EventBuilder {
+    public:
+        // onWorkerStart runs first on every shard worker, e.g. to pin it
+        ShardedEventBuilder(std::size_t arg_totalFEs, std::size_t nShards, std::function<void(std::size_t)> onWorkerStart = nullptr);
+        ~ShardedEventBuilder() override;
+
+        void configure(const json &config) override;
+
+        void add(uint16_t fe_id, EventData &&block, clock::time_point now = clock::now()) override;
+        std::size_t collect(std::vector<ReconstructedBunch> &out, clock::time_point now = clock::now()) override;
+        std::size_t flush(std::vector<ReconstructedBunch> &out) override;
+
+        std::size_t openBunches() const override;
+        std::size_t heldBytes(uint16_t fe_id) const override;
+        std::size_t heldHits(uint16_t fe_id) const override;
+        Stats getStats() const override;
+
+        std::size_t getNumShards() const { return shards.size(); }
+
+    private:
+        // An event waiting for its shard. It still lives in its block in pending
+        struct Item {
+            uint16_t fe_id;
+            BunchKey key;
+            Event* event;
+            clock::time_point arrived;
+        };
+
+        // Runs work(shard) for every shard on the pool and waits for all of them
+        void forEachShard(const std::function<void(std::size_t)> &work);
+        void merge(std::vector<std::vector<ReconstructedBunch>> &parts, std::vector<ReconstructedBunch> &out) const;
+        void limitWindow(std::vector<std::vector<ReconstructedBunch>> &parts); //overflows the oldest bunches of all shards
+        void hold(std::vector<std::vector<ReconstructedBunch>> &parts);        //merges released bunches into held
+        void handOut(std::vector<ReconstructedBunch> &out, uint64_t below);    //moves the held bunches older than below to out
+
+        std::vector<std::unique_ptr<EventBuilder>> shards;
+        std::vector<std::vector<Item>> inbox;        //per shard, filled by add()
+        std::deque<EventData> pending;               //blocks the inbox items point into, dropped after collect()
+        std::deque<ReconstructedBunch> held;         //released by their shard, waiting for older ones; oldest first
+        std::vector<std::size_t> heldFeBytes, heldFeHits;
+        WorkStealingPool pool;
+};
+
+#endif
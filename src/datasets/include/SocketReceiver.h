@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <poll.h>
 
 #include <arpa/inet.h>
 
@@ -27,7 +28,8 @@ public:
     void join() override;
 
 private:
-    void process();
+    LoopStep step() override;
+    bool readable() const;
     bool getPacket(std::vector<uint8_t>& buffer) const;
     void processPacket(std::vector<uint8_t>& buffer);
 
@@ -40,6 +42,9 @@ private:
     int connections;
 
     unsigned total_events, packet_counter, total_hits, max_retry_delay;
+    unsigned poll_interval; // microseconds between readiness checks when running on a shared executor
+    uint32_t batch_n;
+    std::chrono::steady_clock::time_point last;
     bool run_thread, is_connected, socket_created;
     int fd;
 
@@ -25,7 +25,8 @@ public:
     void join() override;
 
 private:
-    void process();
+    LoopStep step() override;
+    bool readable() const;
     bool getPacket(std::vector<uint8_t>& buffer) const;
     void processPacket(std::vector<uint8_t>& buffer);
 
@@ -34,11 +35,13 @@ private:
     std::string name, server_ip, port;
 
     unsigned   total_events, packet_counter, total_hits, max_retry_delay;
+    unsigned   poll_interval; // microseconds between readiness checks on a shared executor
+    uint32_t   batch_n;
+    std::chrono::steady_clock::time_point last;
     uint8_t    max_connection_retries, current_retry;
     bool       run_thread, is_connected;
 
     std::unique_ptr<EventData>   curEvents;
-    std::unique_ptr<std::thread> thread_ptr;
 
     zmq::context_t                    context;
     std::unique_ptr<zmq::socket_t>    subscriber;
@@ -21,7 +21,7 @@ public:
 
 private:
     // implementation
-    void process();
+    LoopStep step() override;
     void processBatch();
     bool fromFile();
 
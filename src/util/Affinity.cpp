@@ -0,0 +1,172 @@
+#include "Affinity.h"
+#include "logging.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef VIZ_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace
+{
+    auto logger = logging::make_log("Affinity");
+
+#ifdef VIZ_HAVE_NUMA
+    class NumaResource : public std::pmr::memory_resource {
+        public:
+            explicit NumaResource(int arg_node) : node(arg_node) {}
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t /*alignment*/) override {
+                void* p = numa_alloc_onnode(bytes, node); // page aligned
+                if(!p)
+                    throw std::bad_alloc();
+                return p;
+            }
+            void do_deallocate(void* p, std::size_t bytes, std::size_t /*alignment*/) override {
+                numa_free(p, bytes);
+            }
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            int node;
+    };
+
+    bool numaUsable() {
+        static const bool usable = numa_available() >= 0;
+        return usable;
+    }
+#endif
+}
+
+namespace affinity {
+    std::string Placement::describe() const {
+        if(!any())
+            return "unpinned";
+
+        std::stringstream ss;
+        if(!cpus.empty()) {
+            ss << "cpus ";
+            for(std::size_t i = 0; i < cpus.size(); i++)
+                ss << (i ? "," : "") << cpus[i];
+        }
+        if(node >= 0)
+            ss << (cpus.empty() ? "" : ", ") << "numa node " << node;
+        return ss.str();
+    }
+
+    std::vector<int> parseCpuList(const std::string &list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string item;
+        while(std::getline(ss, item, ',')) {
+            if(item.empty())
+                continue;
+            std::size_t dash = item.find('-');
+            try {
+                if(dash == std::string::npos) {
+                    cpus.push_back(std::stoi(item));
+                }
+                else {
+                    int first = std::stoi(item.substr(0, dash)), last = std::stoi(item.substr(dash + 1));
+                    for(int cpu = first; cpu <= last; cpu++)
+                        cpus.push_back(cpu);
+                }
+            }
+            catch(const std::logic_error &) {
+                throw std::invalid_argument("Malformed CPU list '" + list + "'");
+            }
+        }
+        return cpus;
+    }
+
+    Placement parsePlacement(const json &config) {
+        Placement placement;
+        if(config.contains("cpus")) {
+            if(config["cpus"].is_string())
+                placement.cpus = parseCpuList(config["cpus"].get<std::string>());
+            else if(config["cpus"].is_array())
+                placement.cpus = config["cpus"].get<std::vector<int>>();
+            else
+                throw std::invalid_argument("\"cpus\" must be a list or a string like \"0-3,8\"");
+        }
+        if(config.contains("numa_node"))
+            placement.node = (int)config["numa_node"];
+
+        if(placement.cpus.empty() && placement.node >= 0)
+            placement.cpus = nodeCpus(placement.node);
+        return placement;
+    }
+
+    int numNodes() {
+#ifdef VIZ_HAVE_NUMA
+        if(numaUsable())
+            return numa_max_node() + 1;
+#endif
+        int n = 0;
+        while(std::ifstream("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist").good())
+            n++;
+        return std::max(n, 1);
+    }
+
+    std::vector<int> nodeCpus(int node) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if(!in || !std::getline(in, list)) {
+            logger->warn("NUMA node {} not found, placement falls back to all CPUs", node);
+            return {};
+        }
+        return parseCpuList(list);
+    }
+
+    bool pinCurrentThread(const Placement &placement) {
+        bool ok = true;
+        if(!placement.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(int cpu : placement.cpus) {
+                if(cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+            }
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if(err != 0) {
+                logger->warn("Could not pin thread to {}: {}", placement.describe(), std::strerror(err));
+                ok = false;
+            }
+        }
+#ifdef VIZ_HAVE_NUMA
+        if(placement.node >= 0 && numaUsable())
+            numa_set_preferred(placement.node);
+#endif
+        return ok;
+    }
+
+    std::pmr::memory_resource* nodeResource(int node) {
+#ifdef VIZ_HAVE_NUMA
+        if(node >= 0 && numaUsable()) {
+            static std::mutex mutex;
+            static std::map<int, std::unique_ptr<NumaResource>> resources;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& resource = resources[node];
+            if(!resource)
+                resource = std::make_unique<NumaResource>(node);
+            return resource.get();
+        }
+#else
+        (void)node;
+#endif
+        return std::pmr::new_delete_resource();
+    }
+}
@@ -0,0 +1,151 @@
+#include "Executor.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Pool and queue of the calling worker thread; currentPool is null outside of any pool
+    thread_local const WorkStealingPool* currentPool = nullptr;
+    thread_local std::size_t currentIdx = 0;
+
+    struct LaterDue {
+        template <class T>
+        bool operator()(const T& a, const T& b) const { return a.due > b.due; }
+    };
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t nThreads, std::function<void(std::size_t)> onWorkerStart) {
+    if(nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    queues.reserve(nThreads);
+    for(std::size_t i = 0; i < nThreads; i++)
+        queues.push_back(std::make_unique<Queue>());
+
+    workers.reserve(nThreads);
+    for(std::size_t i = 0; i < nThreads; i++)
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i, onWorkerStart);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for(auto& worker : workers)
+        worker.join();
+}
+
+void WorkStealingPool::push(std::size_t idx, Task task) {
+    pending++; // counted before it becomes visible so pending never underflows
+    {
+        std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+        queues[idx]->tasks.push_back(std::move(task));
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    std::size_t idx = (currentPool == this) ? currentIdx : nextQueue++ % queues.size();
+    push(idx, std::move(task));
+
+    // taking the lock orders the increment of pending before a worker's last check
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    sleepCv.notify_one();
+}
+
+void WorkStealingPool::submitAfter(std::chrono::microseconds delay, Task task, const void* owner) {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        timers.push_back({std::chrono::steady_clock::now() + delay, std::move(task), owner});
+        std::push_heap(timers.begin(), timers.end(), LaterDue());
+    }
+    sleepCv.notify_one(); // the new timer may be the earliest one
+}
+
+void WorkStealingPool::wakeDelayed(const void* owner) {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        auto now = std::chrono::steady_clock::now();
+        for(auto& timer : timers) {
+            if(timer.owner == owner)
+                timer.due = now;
+        }
+        std::make_heap(timers.begin(), timers.end(), LaterDue());
+    }
+    sleepCv.notify_all();
+}
+
+bool WorkStealingPool::releaseDue(std::size_t idx) {
+    bool released = false;
+    auto now = std::chrono::steady_clock::now();
+    while(!timers.empty() && timers.front().due <= now) {
+        std::pop_heap(timers.begin(), timers.end(), LaterDue());
+        push(idx, std::move(timers.back().task));
+        timers.pop_back();
+        released = true;
+    }
+    return released;
+}
+
+// The own queue is FIFO too: a loader that resubmits itself goes behind the tasks
+// already queued, so one source that always has data cannot hold its worker
+bool WorkStealingPool::tryRun(std::size_t idx) {
+    Task task;
+    {
+        Queue& own = *queues[idx];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+        }
+    }
+
+    for(std::size_t i = 1; !task && i < queues.size(); i++) {
+        Queue& victim = *queues[(idx + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            numSteals++;
+        }
+    }
+
+    if(!task)
+        return false;
+
+    pending--;
+    task();
+    numExecuted++;
+    return true;
+}
+
+void WorkStealingPool::workerLoop(std::size_t idx, std::function<void(std::size_t)> onWorkerStart) {
+    currentPool = this;
+    currentIdx = idx;
+    if(onWorkerStart)
+        onWorkerStart(idx);
+
+    while(true) {
+        // timers fall due while every worker is busy too; whoever gets the lock first queues them
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex, std::try_to_lock);
+            if(lock.owns_lock() && !timers.empty())
+                releaseDue(idx);
+        }
+        if(tryRun(idx))
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if(stopping)
+            break;
+        if(releaseDue(idx) || pending > 0)
+            continue;
+
+        if(timers.empty())
+            sleepCv.wait(lock);
+        else
+            sleepCv.wait_until(lock, timers.front().due);
+    }
+    currentPool = nullptr;
+}
@@ -1,5 +1,11 @@
 #include "cli.h"
 
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
 namespace cli_helpers {
 
     std::shared_ptr<spdlog::logger> logger = logging::make_log("VizCLI");
@@ -101,11 +107,14 @@ int VisualizerCli::parseOptions(int argc, char *argv[]) {
 }
 
 VisualizerCli::VisualizerCli() {
-    uncompletedReconEvents = std::make_unique<std::vector<ReconstructedBunch>>();
+    notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(notifyFd < 0)
+        logger->warn("Could not create readiness eventfd ({}), waitForData falls back to polling", std::strerror(errno));
 }
 
 VisualizerCli::~VisualizerCli() {
-
+    if(notifyFd >= 0)
+        close(notifyFd);
 }
 
 int VisualizerCli::init(int argc, char** argv, CLIstate argstate) {
@@ -145,10 +154,21 @@ int VisualizerCli::configure() {
         logger->warn("No sources listed in config file");
     }
     
+    // thread placement defaults; sources may override "loaders" with their own "placement"
+    if(config.contains("viz_config") && config["viz_config"].contains("placement")) {
+        try {
+            for(auto& role : config["viz_config"]["placement"].items())
+                rolePlacements[role.key()] = affinity::parsePlacement(role.value());
+        }
+        catch(const std::invalid_argument &e) {
+            logger->error("Invalid viz_config placement: {}", e.what());
+            return -1;
+        }
+    }
+
     names.reserve(numSources);
     configIdMap.reserve(numSources);
     clipboards.reserve(numSources);
-    curr_fe_bcid.reserve(numSources);
     
     for(int i = 0, k=0; i < numSources; i++) {
         auto source = config["sources"][i];
@@ -185,9 +205,45 @@ int VisualizerCli::configure() {
             dataLoaders.push_back(StdDict::getDataLoader(source["type"]));
             feIdMap[source["name"]] = k;
             names.push_back(source["name"]);
-            curr_fe_bcid.push_back(0);
             configIdMap.push_back(i);
-            clipboards.push_back(std::make_shared<ClipBoard<EventData>>());
+            memoryBudgets.push_back(source.contains("memory_budget") ? (std::size_t)source["memory_budget"] : 0);
+            // "clipboard": "ring" selects the lock-free SPSC ring, bounded to "clipboard_capacity" blocks
+            std::size_t ringCapacity = 0;
+            if(source.contains("clipboard") && source["clipboard"] == "ring")
+                ringCapacity = source.contains("clipboard_capacity") ? (std::size_t)source["clipboard_capacity"] : 1024;
+            clipboards.push_back(std::make_shared<ClipBoard<EventData>>(ringCapacity));
+            clipboards.back()->setNotifyFd(notifyFd);
+            affinity::Placement placement = getPlacement("loaders");
+            if(source.contains("placement")) {
+                try {
+                    placement = affinity::parsePlacement(source["placement"]);
+                }
+                catch(const std::invalid_argument &e) {
+                    logger->error("Invalid placement for frontend {} with name '{}': {}", k, source["name"], e.what());
+                    return -1;
+                }
+            }
+            dataLoaders[k]->setPlacement(placement);
+
+            // loaders share a work-stealing pool per placement unless "executor": "thread" asks for a dedicated thread
+            if(!source.contains("executor") || source["executor"] == "pool") {
+                auto& pool = loaderPools[placement.describe()];
+                if(!pool) {
+                    std::size_t nThreads = 0;
+                    if(config.contains("viz_config") && config["viz_config"].contains("loader_threads"))
+                        nThreads = (std::size_t)config["viz_config"]["loader_threads"];
+                    if(!placement.cpus.empty() && (nThreads == 0 || nThreads > placement.cpus.size()))
+                        nThreads = placement.cpus.size();
+                    std::function<void(std::size_t)> pin;
+                    if(placement.any())
+                        pin = [placement](std::size_t) { affinity::pinCurrentThread(placement); };
+                    pool = std::make_shared<WorkStealingPool>(nThreads, pin);
+                    logger->info("Data loader pool with {} worker threads ({})", pool->concurrency(), placement.describe());
+                }
+                dataLoaders[k]->setExecutor(pool);
+            }
+            dataLoaders[k]->configureBatches(source);
+            dataLoaders[k]->configureTimeline(source);
             dataLoaders[k++]->configure(source);
         }
         else {
@@ -195,11 +251,43 @@ int VisualizerCli::configure() {
         }
     }
 
+    //atomics cannot be pushed back, so the counters are sized once every source is known
+    builderBytes = std::vector<std::atomic<std::size_t>>(clipboards.size());
+    builderHits = std::vector<std::atomic<std::size_t>>(clipboards.size());
+    consumerBytes = std::vector<std::atomic<std::size_t>>(clipboards.size());
+    consumerHits = std::vector<std::atomic<std::size_t>>(clipboards.size());
+
     logger->info("Initalizing and connecting data loaders...");
     for(int i = 0; i < dataLoaders.size(); i++) {
         dataLoaders[i]->init();
         dataLoaders[i]->connect(clipboards[i]);
     }
+
+    // "threads" > 1 shards the bunches over that many builder threads, placed like the builder role
+    json builderConfig = json::object();
+    if(config.contains("viz_config") && config["viz_config"].contains("event_builder"))
+        builderConfig = config["viz_config"]["event_builder"];
+    std::size_t builderThreads = builderConfig.contains("threads") ? (std::size_t)builderConfig["threads"] : 1;
+    if(builderThreads > 1) {
+        affinity::Placement placement = getPlacement("builder");
+        std::function<void(std::size_t)> pin;
+        if(placement.any())
+            pin = [placement](std::size_t) { affinity::pinCurrentThread(placement); };
+        builder = std::make_unique<ShardedEventBuilder>(clipboards.size(), builderThreads, pin);
+        logger->info("Event builder sharded over {} threads ({})", builderThreads, placement.describe());
+    }
+    else {
+        builder = std::make_unique<EventBuilder>(clipboards.size());
+    }
+    if(!builderConfig.empty()) {
+        try {
+            builder->configure(builderConfig);
+        }
+        catch(const std::invalid_argument &e) {
+            logger->error("Invalid viz_config event_builder: {}", e.what());
+            return -1;
+        }
+    }
     return 0;
 }
 
@@ -209,19 +297,41 @@ int VisualizerCli::start() {
         return 0;
     }
 
-    logger->info("Starting data loaders for {} threads", dataLoaders.size());
+    logger->info("Starting {} data loaders", dataLoaders.size());
+    for(int i = 0; i < dataLoaders.size(); i++) {
+        logger->info("[{}]: placement {} on {}", names[i], dataLoaders[i]->getPlacement().describe(),
+            dataLoaders[i]->usesExecutor() ? "the shared loader pool" : "its own thread");
+    }
+    logger->info("Event builder placement {}, render placement {} ({} NUMA nodes)", getPlacement("builder").describe(),
+        getPlacement("render").describe(), affinity::numNodes());
     for(int i = 0; i < dataLoaders.size(); i++) {
         dataLoaders[i]->run();
     }
 
+    stopping = false;
     started = true;
     return 0;
 }
 
 int VisualizerCli::stop() {
+    // consumers checking isRunning() leave the clipboards alone from here on
+    started = false;
+    stopping = true;
+    if(notifyFd >= 0) { // wake anyone blocked in waitForData, which sees stopping and returns
+        uint64_t one = 1;
+        ssize_t ret = write(notifyFd, &one, sizeof(one));
+        (void)ret;
+    }
     for(int i = 0; i < dataLoaders.size(); i++) {
+        clipboards[i]->finish(); // releases a loader blocked on a full ring
         dataLoaders[i]->join();
-        logger->info("Clipboard for FE with ID {}: size {} / {}", i, clipboards[i]->getNumDataIn(), clipboards[i]->size());
+        const TimelineStats& timeline = dataLoaders[i]->getTimelineStats();
+        logger->info("[{}]: timeline of {} events: {} bcid / {} l1id wraps, {} backsteps, {} arrival gaps ({} resynced)", names[i],
+            timeline.events, timeline.bcidWraps, timeline.l1idWraps, timeline.backsteps, timeline.gaps, timeline.resyncs);
+        if(clipboards[i]->getNumDropped() > 0)
+            logger->warn("Clipboard for FE with ID {}: dropped {} blocks while stopping", i, clipboards[i]->getNumDropped());
+        logger->info("Clipboard for FE with ID {}: size {} / {} ({} bytes, {} hits left)", i, clipboards[i]->getNumDataIn(), clipboards[i]->size(),
+            clipboards[i]->getBytes(), clipboards[i]->getHits());
         dataLoaders[i].reset();
         while(clipboards[i]->size() > 0) {
             auto raw = clipboards[i]->popData();
@@ -229,6 +339,19 @@ int VisualizerCli::stop() {
         }   
         clipboards[i].reset();
     }
+    for(auto& pool : loaderPools) {
+        logger->info("Data loader pool ({}): {} tasks executed, {} stolen", pool.first, pool.second->getNumExecuted(), pool.second->getNumSteals());
+    }
+    loaderPools.clear();
+    if(builder) {
+        EventBuilder::Stats stats = builder->getStats();
+        logger->info("Event builder: {} bunches ({} complete, {} timed out, {} window overflows), {} late events, {} left open",
+            stats.bunches, stats.complete, stats.timedOut, stats.overflowed, stats.lateEvents, builder->openBunches());
+        if(builder->getMatching() == EventBuilder::Matching::Composite) {
+            for(int i = 0; i < names.size(); i++)
+                logger->info("[{}]: bcid offset {}, l1id offset {} ({} calibrations)", names[i], builder->getBcidOffset(i), builder->getL1idOffset(i), stats.calibrations);
+        }
+    }
     return 0;
 }
 
@@ -238,7 +361,10 @@ void VisualizerCli::listFEs() {
         auto temp = getConfig(i);
 
         logger->info("[{}]: FE with ID {}", names[i], i);
-        logger->info("[{}]:  - Clipboard I/O sizes {}/{}", names[i], clipboards[i]->getNumDataIn(), clipboards[i]->getNumDataOut());
+        logger->info("[{}]:  - Clipboard ({}) I/O sizes {}/{}", names[i], clipboards[i]->isRing() ? "ring" : "mutex",
+            clipboards[i]->getNumDataIn(), clipboards[i]->getNumDataOut());
+        logger->info("[{}]:  - Runs on {} ({})", names[i], dataLoaders[i]->usesExecutor() ? "the shared loader pool" : "its own thread",
+            dataLoaders[i]->getPlacement().describe());
         
         // std::vector<int> position = temp["position"].get<std::vector<int>>();
         // std::vector<int> angle = temp["angle"].get<std::vector<int>>();
@@ -265,6 +391,106 @@ const json& VisualizerCli::getConfig(std::string fe_id) const{
     return config["sources"][configIdMap[feIdMap.at(fe_id)]];
 }
 
+affinity::Placement VisualizerCli::getPlacement(const std::string& role) const{
+    auto it = rolePlacements.find(role);
+    if(it == rolePlacements.end())
+        return affinity::Placement();
+    return it->second;
+}
+
+void VisualizerCli::pinCurrentThread(const std::string& role) const{
+    affinity::Placement placement = getPlacement(role);
+    if(!placement.any())
+        return;
+    if(affinity::pinCurrentThread(placement))
+        logger->info("Pinned {} thread to {}", role, placement.describe());
+}
+
+bool VisualizerCli::hasData(int fe_id) const{
+    if(!(fe_id >= 0 && fe_id < clipboards.size()) || !clipboards[fe_id])
+        return false;
+    return !clipboards[fe_id]->empty();
+}
+
+//The eventfd counter is cleared before the clipboards are checked, so a push racing with this call
+//either shows up in the check or leaves the fd readable for the poll below
+//stop() sets stopping before it signals the fd, so a wake-up by stop() returns false right away
+bool VisualizerCli::waitForData(std::chrono::microseconds timeout) const{
+    auto anyData = [this]() {
+        for(int i = 0; i < clipboards.size(); i++) {
+            if(hasData(i))
+                return true;
+        }
+        return false;
+    };
+
+    if(notifyFd < 0) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(!anyData()) {
+            if(stopping || std::chrono::steady_clock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(true) {
+        if(stopping)
+            return false;
+        uint64_t counter;
+        ssize_t ret = read(notifyFd, &counter, sizeof(counter));
+        (void)ret;
+        if(stopping)
+            return false;
+        if(anyData())
+            return true;
+
+        auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+        if(left.count() <= 0)
+            return false;
+
+        struct pollfd pfd = {notifyFd, POLLIN, 0};
+        struct timespec ts = {(time_t)(left.count() / 1000000000), (long)(left.count() % 1000000000)};
+        int n = ppoll(&pfd, 1, &ts, nullptr);
+        if(n < 0)
+            return false; // interrupted, e.g. by SIGINT: let the caller check its flags
+        if(n == 0)
+            return !stopping && anyData();
+    }
+}
+
+MemoryStats VisualizerCli::getMemoryStats(int fe_id) const{
+    MemoryStats stats;
+    if(!(fe_id >= 0 && fe_id < clipboards.size())) {
+        logger->error("No frontend with index {} found in list! Returned memory stats are empty", fe_id);
+        return stats;
+    }
+
+    if(dataLoaders[fe_id]) {
+        stats.loaderBytes = dataLoaders[fe_id]->pendingBytes();
+        stats.loaderHits = dataLoaders[fe_id]->pendingHits();
+    }
+    if(clipboards[fe_id]) {
+        stats.clipboardBytes = clipboards[fe_id]->getBytes();
+        stats.clipboardHits = clipboards[fe_id]->getHits();
+        stats.clipboardBlocks = clipboards[fe_id]->size();
+    }
+    stats.builderBytes = builderBytes[fe_id].load(std::memory_order_relaxed);
+    stats.builderHits = builderHits[fe_id].load(std::memory_order_relaxed);
+    stats.consumerBytes = consumerBytes[fe_id].load(std::memory_order_relaxed);
+    stats.consumerHits = consumerHits[fe_id].load(std::memory_order_relaxed);
+    stats.budget = memoryBudgets[fe_id];
+    return stats;
+}
+
+void VisualizerCli::setConsumerMemory(int fe_id, std::size_t bytes, std::size_t hits){
+    if(!(fe_id >= 0 && fe_id < clipboards.size()))
+        return;
+    consumerBytes[fe_id].store(bytes, std::memory_order_relaxed);
+    consumerHits[fe_id].store(hits, std::memory_order_relaxed);
+}
+
 std::unique_ptr<EventData> VisualizerCli::getRawData(int fe_id) const{
 
     if(!(fe_id >= 0 && fe_id < clipboards.size())) {
@@ -282,26 +508,44 @@ std::unique_ptr<EventData> VisualizerCli::getRawData(std::string fe_id)const{
     return getRawData(feIdMap.at(fe_id));
 }
 
-std::unique_ptr<std::vector<Event>> VisualizerCli::loadEvents(int fe_id, bool get_all) const{
-    auto result = std::make_unique<std::vector<Event>>();
-    // clipboards[fe_id].size();
-    uint32_t procLoop = 1;
-    std::unique_ptr<EventData> proc;
-    do {
-        //std::cout << "procLoop: " <<  procLoop << std::endl;
-        procLoop++;
-        if(proc) proc.reset();
-        proc = getRawData(fe_id);
-        if(proc) {
-            result = std::make_unique<std::vector<Event>>(std::move(proc->events));
-        }
-    } 
-    while(proc && get_all);
+//Pops one block, or with get_all every queued block in a single hand-over from the clipboard
+std::deque<std::unique_ptr<EventData>> VisualizerCli::drainBlocks(int fe_id, bool get_all) const{
+    std::deque<std::unique_ptr<EventData>> blocks;
+    if(!(fe_id >= 0 && fe_id < clipboards.size())) {
+        logger->error("No frontend with index {} found in list! Returned data is empty", fe_id);
+        return blocks;
+    }
+
+    if(get_all)
+        return clipboards[fe_id]->drainAll();
+
+    std::unique_ptr<EventData> block = clipboards[fe_id]->popData();
+    if(block)
+        blocks.push_back(std::move(block));
+    return blocks;
+}
+
+//Drained blocks are concatenated into the first one. If its source uses a batch arena, the events stay valid
+//for as long as the returned EventData lives and are released together with it
+std::unique_ptr<EventData> VisualizerCli::loadEvents(int fe_id, bool get_all) const{
+    auto blocks = drainBlocks(fe_id, get_all);
+    if(blocks.empty())
+        return std::make_unique<EventData>();
+
+    size_t totalEvents = 0;
+    for(const auto& block : blocks)
+        totalEvents += block->events.size();
+
+    std::unique_ptr<EventData> result = std::move(blocks.front());
+    result->events.reserve(totalEvents);
+
+    for(size_t i = 1; i < blocks.size(); i++)
+        result->addEventData(std::move(*blocks[i]));
 
     return result;
 }
 
-std::unique_ptr<std::vector<Event>> VisualizerCli::loadEvents(std::string fe_id, bool get_all) const{
+std::unique_ptr<EventData> VisualizerCli::loadEvents(std::string fe_id, bool get_all) const{
     if(feIdMap.find(fe_id) == feIdMap.end()) {
         logger->error("No frontend with name {} found in list! Returned data is nullptr", fe_id);
         return nullptr;
@@ -315,10 +559,19 @@ std::unique_ptr<std::vector<pixelHit>> VisualizerCli::getData(int fe_id, bool ge
 
     auto result = std::make_unique<std::vector<pixelHit>>();
 
-    auto events = loadEvents(fe_id, get_all);
-    for(int i = 0; i < events->size(); i++) {
-        for(int j = 0; j < (*events)[i].hits.size(); j++) {
-            result->push_back({(uint16_t)(*events)[i].hits[j].row, (uint16_t)(*events)[i].hits[j].col});
+    //No need to concatenate the events first: hits are read straight out of every drained block
+    auto blocks = drainBlocks(fe_id, get_all);
+    size_t totalHits = 0;
+    for(const auto& block : blocks)
+        totalHits += block->nHits;
+    result->reserve(totalHits);
+
+    for(const auto& block : blocks) {
+        const auto& events = block->events;
+        for(int i = 0; i < events.size(); i++) {
+            for(int j = 0; j < events[i].hits.size(); j++) {
+                result->push_back({(uint16_t)events[i].hits[j].row, (uint16_t)events[i].hits[j].col});
+            }
         }
     }
 
@@ -336,14 +589,21 @@ std::unique_ptr<std::vector<pixelHit>> VisualizerCli::getData(std::string fe_id,
     return getData(feIdMap.at(fe_id), get_all);
 }
 
-std::unique_ptr<std::vector<Event>> VisualizerCli::getEvents(int fe_id, bool get_all) const{
+std::deque<std::unique_ptr<EventData>> VisualizerCli::getBlocks(int fe_id, bool get_all) const{
+    if(!(state == CLIstate::NORMAL))
+        return {};
+
+    return drainBlocks(fe_id, get_all);
+}
+
+std::unique_ptr<EventData> VisualizerCli::getEvents(int fe_id, bool get_all) const{
     if(!(state == CLIstate::NORMAL))
         return nullptr;
 
     return loadEvents(fe_id, get_all);
 }
 
-std::unique_ptr<std::vector<Event>> VisualizerCli::getEvents(std::string fe_id, bool get_all) const{
+std::unique_ptr<EventData> VisualizerCli::getEvents(std::string fe_id, bool get_all) const{
     if(!(state == CLIstate::NORMAL))
         return nullptr;
 
@@ -355,132 +615,27 @@ std::unique_ptr<std::vector<Event>> VisualizerCli::getEvents(std::string fe_id,
 }
 
 std::unique_ptr<std::vector<ReconstructedBunch>> VisualizerCli::getReconstructedBunch(){
-    numloops++;
-
-    uint8_t totalFEs = clipboards.size();
-    uint32_t largest_bcid = 0;
-    uint32_t smallestTail_bcid = UINT32_MAX;
-    std::vector<std::unique_ptr<EventData>> loadersEventData(totalFEs);
-    std::vector<std::vector<ReconstructedBunch>> loadersReconBunch(totalFEs);
-    
-    std::cout << "Here 1\n";
-
-    bool noEventsOccured = true;
-    for(int i = 0; i < totalFEs; i++){
-        loadersEventData[i] = getRawData(i);
-        if(loadersEventData[i] && !loadersEventData[i]->empty()){
-
-            uint32_t first_bcid = loadersEventData[i]->events.front().bcid;
-            uint32_t last_bcid = loadersEventData[i]->events.back().bcid;
-
-            largest_bcid = std::max(largest_bcid, last_bcid);
-            smallestTail_bcid = std::min(smallestTail_bcid, last_bcid);
-
-            for(uint32_t bcid = first_bcid; bcid <= last_bcid; bcid++){
-                ReconstructedBunch tempBunch(bcid, totalFEs);
-                tempBunch.addEventDataCI(*loadersEventData[i], i); //bcidChangeIndex should be defined in data loaders
-                loadersReconBunch[i].push_back(std::move(tempBunch));
-            }
-
-            noEventsOccured = false;
-        }
-        // if(!temp[i]->empty()){
-        //     std::cout << "ID: " << numloops << " // Loader " << i << " with // front_bcid: " <<  temp[i]->front().bcid << " and back_bcid: " << temp[i]->back().bcid  << "Size: " << temp[i]->size() << std::endl;
-        //     std::cout << " |------------------------> front_hits: " << temp[i]->front().nHits << " and back_hits: " << temp[i]->back().nHits << std::endl;
-        // }
-    }
-    if(noEventsOccured)
+    if(!builder)
         return nullptr;
 
-    std::cout << "ID: " << numloops << std::endl;
-
-
-    //FUTURE SELF - THIS WILL BREAK CODE. IT WAS AN EARLIER ATTEMPT
-    // std::vector<std::unique_ptr<std::vector<Event>>> temp(totalFEs);
-    // std::cout << "ID: " << numloops << " Here 1\n";
-    // //Determine the overlapped events
-    // for(int i = 0; i < temp.size(); i++){
-    //     temp[i] = loadEvents(i);
-
-    //     if(!temp[i]->empty()){
-    //         largest_bcid = std::max(largest_bcid, temp[i]->back().bcid);
-    //         smallestTail_bcid = std::min(smallestTail_bcid, temp[i]->back().bcid);
-    //         std::cout << "Loader " << i << " with // front_bcid: " <<  temp[i]->front().bcid << " and back_bcid: " << temp[i]->back().bcid  << std::endl;
-    //         noEventsOccured = false;
-    //     }
-    // }
-    // if(noEventsOccured)
-    //     return nullptr;
-
-
-    std::cout << "-----largest_bcid: " << largest_bcid << std::endl;
-    std::cout << "-----smallestTail_bcid:  " << smallestTail_bcid << std::endl; 
-    std::cout << "-----firstuncompleted_bcid: " << firstuncompleted_bcid << std::endl;
-    std::cout << "-----firstuntouched_bcid: " << firstuntouched_bcid << std::endl;
-    
-    std::cout << "ID: " << numloops << " Here 2\n";
-
-    //Initialize new reconstructed events with appropriate bcid
-    for(uint32_t bcid = firstuntouched_bcid; bcid <= smallestTail_bcid; bcid++){
-        uncompletedReconEvents->push_back(ReconstructedBunch(bcid, totalFEs));
-    }
-
-    std::cout << "ID: " << numloops << " Here 3\n";
-
-    //Fill in completed events to return. Completed events are the events with bcid less than the smallest tail bcid.
-    for(int i = 0; i < totalFEs; i++){
-        if(loadersEventData[i] && !loadersEventData[i]->empty()){
-            uint32_t first_bcid = loadersReconBunch[i].front().bcid;
-            size_t globalIndex = first_bcid - firstuncompleted_bcid;
-            for(uint32_t bcid = first_bcid; bcid < smallestTail_bcid; bcid++){
-                size_t index = bcid - first_bcid;
-                (*uncompletedReconEvents)[globalIndex + index].addEventData(*((loadersReconBunch[i])[index].getEventDataFE(i)), i);
-            }
-        }
+    for(int i = 0; i < clipboards.size(); i++){
+        if(!clipboards[i])
+            continue;
+        for(auto& block : drainBlocks(i, true))
+            builder->add(i, std::move(*block));
     }
 
-    std::cout << "Here 3.5" << std::endl;
+    std::unique_ptr<std::vector<ReconstructedBunch>> bunches = std::make_unique<std::vector<ReconstructedBunch>>();
+    builder->collect(*bunches);
 
-    std::unique_ptr<std::vector<ReconstructedBunch>> reconstructedReturn = std::make_unique<std::vector<ReconstructedBunch>>();
-    if(uncompletedReconEvents->size() > 1){ //if size is 1, then still working on one bcid
-        reconstructedReturn->insert(reconstructedReturn->begin(), uncompletedReconEvents->begin(), uncompletedReconEvents->begin() + (smallestTail_bcid - uncompletedReconEvents->front().bcid));
-        uncompletedReconEvents->erase(uncompletedReconEvents->begin(), uncompletedReconEvents->begin() + (smallestTail_bcid - uncompletedReconEvents->front().bcid));
+    //Memory held back by the builder, per source
+    for(int i = 0; i < clipboards.size(); i++){
+        builderBytes[i].store(builder->heldBytes(i), std::memory_order_relaxed);
+        builderHits[i].store(builder->heldHits(i), std::memory_order_relaxed);
     }
-    std::cout << "ID: " << numloops << " Here 4\n";
-
-    //Reset variables to load in the uncompleted events
-    firstuncompleted_bcid = smallestTail_bcid;
-    firstuntouched_bcid = largest_bcid + 1;
 
-    for(uint32_t bcid = firstuncompleted_bcid; bcid < firstuntouched_bcid; bcid++){
-        uncompletedReconEvents->push_back(ReconstructedBunch(bcid, totalFEs));
-    }
-    
-    std::cout << "ID: " << numloops << " Here 5\n";
-
-    std::cout << "Uncompleted Recon Events Size: " << uncompletedReconEvents->size() << std::endl;
-
-    //Fill up uncompletedReconEvents with new uncompleted events
-    for(int i = 0; i < loadersReconBunch.size(); i++){
-        if(loadersEventData[i] && !loadersEventData[i]->empty()){
-            size_t globalIndex = firstuncompleted_bcid - loadersReconBunch[i].front().bcid;
-            std::cout << "global index " << globalIndex << std::endl;
-            std::cout << "front bcid of the " << i << "th loader: " << loadersReconBunch[i].front().bcid << std::endl;
-            std::cout << "back bcid of the " << i << "th loader: " << loadersReconBunch[i].back().bcid << std::endl;
-
-            for(uint32_t bcid = firstuncompleted_bcid; bcid <= loadersReconBunch[i].back().bcid; bcid++){
-                size_t index = bcid - firstuncompleted_bcid;
-
-                std::cout << "Loaders Recon Bunch: " << i << " size: " << loadersReconBunch[i].size() << std::endl;
-                std::cout << "index: " << index << std::endl;
-                (*uncompletedReconEvents)[index].addEventData(*((loadersReconBunch[i])[globalIndex + index].getEventDataFE(i)), i);
-            }
-        }
-    }
-
-    std::cout << "ID: " << numloops << " Here 6\n";
-
-    std::cout << "Actual nHits: " << nHits << std::endl;
-    return std::move(reconstructedReturn);
+    if(bunches->empty())
+        return nullptr;
+    return bunches;
 }
 
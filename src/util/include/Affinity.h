@@ -0,0 +1,41 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: CPU affinity and NUMA placement of threads and buffers
+// # Comment: NUMA memory policy needs libnuma (VIZ_HAVE_NUMA)
+// #################################################
+
+#include "util.hpp"
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace affinity {
+    // Where a thread should run and where its memory should come from.
+    // Config form: {"cpus": [0, 1] or "0-3,8", "numa_node": 0}. With only a node
+    // the thread may run on any CPU of that node.
+    struct Placement {
+        std::vector<int> cpus;
+        int node = -1;
+
+        bool any() const { return !cpus.empty() || node >= 0; }
+        std::string describe() const;
+    };
+
+    Placement parsePlacement(const json &config); // throws std::invalid_argument on a malformed entry
+    std::vector<int> parseCpuList(const std::string &list);
+
+    int numNodes();
+    std::vector<int> nodeCpus(int node);
+
+    // Pins the calling thread and, with libnuma, prefers node-local allocations for it
+    bool pinCurrentThread(const Placement &placement);
+
+    // Memory resource handing out pages on the given node (new/delete without libnuma or for node < 0)
+    std::pmr::memory_resource* nodeResource(int node);
+}
+
+#endif
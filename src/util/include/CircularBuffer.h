@@ -1,36 +1,142 @@
 #ifndef EVENTBUFFER_H
 #define EVENTBUFFER_H
 
-#include "core/header.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace viz{
-    template <typename T>
+    // Fixed-capacity ring of entries keyed by a non-decreasing Key (time, bcid, ...).
+    // Storage is allocated once; push and pop are O(1), and a full buffer overwrites
+    // its oldest entry. The contents, oldest first, are readable as at most two
+    // contiguous spans.
+    template <typename T, typename Key = std::uint64_t>
     class CircularBuffer{
         public:
+            template <typename U>
+            struct Span{
+                U* ptr = nullptr;
+                std::size_t count = 0;
+
+                U* begin() const { return ptr; }
+                U* end() const { return ptr + count; }
+                std::size_t size() const { return count; }
+                bool empty() const { return count == 0; }
+                U& operator[](std::size_t i) const { return ptr[i]; }
+            };
+
             CircularBuffer() = delete;
-            CircularBuffer(size_t size);
+            explicit CircularBuffer(std::size_t capacity) : buffer(capacity), keys(capacity) {
+                if(capacity == 0)
+                    throw std::invalid_argument("CircularBuffer capacity must be positive");
+            }
+
+            //Returns true if the oldest entry had to be overwritten
+            bool push(Key key, T data){
+                bool evicted = full();
+                buffer[head] = std::move(data);
+                keys[head] = key;
+                head = next(head);
+                if(evicted)
+                    tail = next(tail);
+                else
+                    count++;
+                return evicted;
+            }
+
+            std::unique_ptr<T> pop(){
+                if(isEmpty())
+                    return nullptr;
+                std::unique_ptr<T> oldest = std::make_unique<T>(std::move(buffer[tail]));
+                dropOldest();
+                return oldest;
+            }
+
+            //Drops every entry with key < limit, e.g. everything older than the display window
+            std::size_t evictBefore(Key limit){
+                std::size_t n = 0;
+                while(!isEmpty() && keys[tail] < limit){
+                    dropOldest();
+                    n++;
+                }
+                return n;
+            }
+
+            void clear(){
+                while(!isEmpty())
+                    dropOldest();
+                head = tail = 0;
+            }
+
+            bool isFull() const { return full(); }
+            bool isEmpty() const { return count == 0; }
+            std::size_t size() const { return count; }
+            std::size_t capacity() const { return buffer.size(); }
 
-            void push(T data);
-            std::unique_ptr<T> pop();
-        
-            bool isFull() const {return full;}
-            bool isEmpty() const { return (!full && (head == tail)); }
+            //i = 0 is the oldest entry
+            T& operator[](std::size_t i) { return buffer[(tail + i) % buffer.size()]; }
+            const T& operator[](std::size_t i) const { return buffer[(tail + i) % buffer.size()]; }
+            Key keyAt(std::size_t i) const { return keys[(tail + i) % buffer.size()]; }
 
-            std::vector<T> getBufferData() const;
-            std::unique_ptr<std::vector<T>> releaseData();
+            T& front() { return buffer[tail]; }
+            T& back() { return buffer[prev(head)]; }
+            Key frontKey() const { return keys[tail]; }
+            Key backKey() const { return keys[prev(head)]; }
+
+            //Oldest-first contents as [first, second]; second is empty unless the data wraps
+            std::pair<Span<T>, Span<T>> spans(){
+                return makeSpans<T>(buffer.data());
+            }
+            std::pair<Span<const T>, Span<const T>> spans() const{
+                return makeSpans<const T>(buffer.data());
+            }
+
+            std::vector<T> getBufferData() const{
+                std::vector<T> ordered;
+                ordered.reserve(count);
+                auto parts = spans();
+                ordered.insert(ordered.end(), parts.first.begin(), parts.first.end());
+                ordered.insert(ordered.end(), parts.second.begin(), parts.second.end());
+                return ordered;
+            }
+
+            //Moves the contents out oldest first and leaves the buffer empty
+            std::unique_ptr<std::vector<T>> releaseData(){
+                std::unique_ptr<std::vector<T>> ordered = std::make_unique<std::vector<T>>();
+                ordered->reserve(count);
+                while(!isEmpty()){
+                    ordered->push_back(std::move(buffer[tail]));
+                    dropOldest();
+                }
+                head = tail = 0;
+                return ordered;
+            }
 
         private:
-            bool checkFull() const;
-            bool checkEmpty() const;
+            bool full() const { return count == buffer.size(); }
+            std::size_t next(std::size_t i) const { return (i + 1 == buffer.size()) ? 0 : i + 1; }
+            std::size_t prev(std::size_t i) const { return (i == 0) ? buffer.size() - 1 : i - 1; }
 
-            bool full;
-            size_t m_size;
-            size_t head, tail;
+            void dropOldest(){
+                buffer[tail] = T(); //release what the entry holds; the slot itself stays allocated
+                tail = next(tail);
+                count--;
+            }
+
+            template <typename U, typename P>
+            std::pair<Span<U>, Span<U>> makeSpans(P* data) const{
+                std::size_t firstLen = std::min(count, buffer.size() - tail);
+                return {Span<U>{data + tail, firstLen}, Span<U>{data, count - firstLen}};
+            }
 
             std::vector<T> buffer;
+            std::vector<Key> keys;
+            std::size_t head = 0, tail = 0, count = 0;
     };
 }
 
-
-
-#endif
\ No newline at end of file
+#endif
@@ -16,14 +16,38 @@
 #include <condition_variable>
 #include <chrono>
 #include <typeinfo>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+#include "SpscRing.h"
+
+// Memory accounting hook: specialise for payload types that can report
+// how many bytes and hits a queued block holds
+template <class T>
+struct ClipBoardFootprint {
+    static std::size_t bytes(const T &data) { return sizeof(T); }
+    static std::size_t hits(const T &data) { return 0; }
+};
 
 template <class T>
 class ClipBoard {
     public:
 
-        ClipBoard() : doneFlag(false), numDataIn(0), numDataOut(0) {}
+        ClipBoard() : doneFlag(false), numDataIn(0), numDataOut(0), bytesQueued(0), hitsQueued(0) {}
+
+        // Lock-free variant: a bounded single-producer/single-consumer ring of
+        // ringCapacity blocks replaces the mutex protected deque. Only valid
+        // with exactly one pushing and one popping thread.
+        explicit ClipBoard(std::size_t ringCapacity) : ClipBoard() {
+            if(ringCapacity > 0)
+                ring = std::make_unique<SpscRing<T>>(ringCapacity);
+        }
+
         ~ClipBoard() {
-            while(!dataQueue.empty()) {
+            while(!rawEmpty()) {
                 std::unique_ptr<T> tmp = this->popData();
             }
         }
@@ -34,8 +58,14 @@ class ClipBoard {
         ClipBoard& operator=(const ClipBoard &&l) = delete;
 
         void pushData(std::unique_ptr<T> data) {
+            if(ring) {
+                pushRing(std::move(data));
+                return;
+            }
             queueMutex.lock();
             if (data != NULL) {
+                bytesQueued += ClipBoardFootprint<T>::bytes(*data);
+                hitsQueued += ClipBoardFootprint<T>::hits(*data);
                 dataQueue.push_back(std::move(data));
                 numDataIn++;
             }
@@ -43,32 +73,152 @@ class ClipBoard {
             //static unsigned cnt = 0;
             //std::cout << "Pushed " << cnt++ << " " << typeid(T).name() << " objects so far" << std::endl;
             cvNotEmpty.notify_all();
+            notify();
+        }
+
+        // Non-blocking push for producers that must not wait, e.g. tasks on a
+        // shared executor. Returns false if the ring is full, leaving data with
+        // the caller to retry later; once finish() was called a block that does
+        // not fit is dropped instead. The deque never refuses a block.
+        bool tryPushData(std::unique_ptr<T> &data) {
+            if(!ring) {
+                pushData(std::move(data));
+                return true;
+            }
+            if(data == NULL)
+                return true;
+            std::size_t bytes = ClipBoardFootprint<T>::bytes(*data);
+            std::size_t hits = ClipBoardFootprint<T>::hits(*data);
+            // account before publishing so the consumer never subtracts first
+            bytesQueued += bytes;
+            hitsQueued += hits;
+            if(ring->tryPush(data)) {
+                published();
+                return true;
+            }
+            bytesQueued -= bytes;
+            hitsQueued -= hits;
+            if(doneFlag) {
+                dropData(std::move(data));
+                return true;
+            }
+            return false;
+        }
+
+        // Counts a block the producer gave up on
+        void dropData(std::unique_ptr<T> data) {
+            if(data != NULL)
+                numDropped++;
         }
 
         // User has to take of deletin popped data
         std::unique_ptr<T> popData() {
+            if(ring) {
+                std::unique_ptr<T> tmp = ring->tryPop();
+                if(tmp) {
+                    numDataOut++;
+                    bytesQueued -= ClipBoardFootprint<T>::bytes(*tmp);
+                    hitsQueued -= ClipBoardFootprint<T>::hits(*tmp);
+                }
+                return tmp;
+            }
             queueMutex.lock();
             std::unique_ptr<T> tmp;
             if(!dataQueue.empty()) {
                 tmp = std::move(dataQueue.front());
                 dataQueue.pop_front();
                 numDataOut++;
+                bytesQueued -= ClipBoardFootprint<T>::bytes(*tmp);
+                hitsQueued -= ClipBoardFootprint<T>::hits(*tmp);
             }
             queueMutex.unlock();
             return tmp;
         }
 
+        // Hands over every queued block at once. The deque is swapped out under a
+        // single lock acquisition (the ring is emptied without locking at all).
+        std::deque<std::unique_ptr<T>> drainAll() {
+            std::deque<std::unique_ptr<T>> drained;
+            if(ring) {
+                while(std::unique_ptr<T> tmp = ring->tryPop())
+                    drained.push_back(std::move(tmp));
+            }
+            else {
+                queueMutex.lock();
+                std::swap(dataQueue, drained);
+                queueMutex.unlock();
+            }
+            accountOut(drained);
+            return drained;
+        }
+
+        // Like drainAll, but takes at most n blocks
+        std::deque<std::unique_ptr<T>> popBatch(std::size_t n) {
+            std::deque<std::unique_ptr<T>> drained;
+            if(ring) {
+                while(drained.size() < n) {
+                    std::unique_ptr<T> tmp = ring->tryPop();
+                    if(!tmp)
+                        break;
+                    drained.push_back(std::move(tmp));
+                }
+            }
+            else {
+                queueMutex.lock();
+                if(n >= dataQueue.size()) {
+                    std::swap(dataQueue, drained);
+                }
+                else {
+                    auto last = dataQueue.begin() + n;
+                    std::move(dataQueue.begin(), last, std::back_inserter(drained));
+                    dataQueue.erase(dataQueue.begin(), last);
+                }
+                queueMutex.unlock();
+            }
+            accountOut(drained);
+            return drained;
+        }
+
+        // Only what was actually removed is subtracted: a push or drain may be
+        // between its queue operation and its accounting while this runs
         void clearData() {
-            queueMutex.lock();
-            std::deque<std::unique_ptr<T>> emptyQueue;
-            std::swap(dataQueue, emptyQueue);
-            queueMutex.unlock();
+            std::deque<std::unique_ptr<T>> cleared;
+            if(ring) {
+                // consumer side only, like popData
+                while(std::unique_ptr<T> tmp = ring->tryPop())
+                    cleared.push_back(std::move(tmp));
+            }
+            else {
+                queueMutex.lock();
+                std::swap(dataQueue, cleared);
+                queueMutex.unlock();
+            }
+            unaccount(cleared);
         }
 
-        int size() const {
+        std::size_t size() const {
+          if(ring)
+            return ring->size();
+          std::lock_guard<std::mutex> lock(queueMutex);
           return dataQueue.size();
         }
 
+        // Readiness notification: after every push a counter of 1 is added to the
+        // given eventfd (or pipe), so consumers can block in poll/epoll on one or
+        // more clipboards. -1 disables it. The clipboard does not own the fd.
+        void setNotifyFd(int fd) {
+            notifyFd = fd;
+        }
+
+        bool isRing() const {
+            return ring != nullptr;
+        }
+
+        // Blocks dropped because the ring was still full when the producer gave up
+        unsigned getNumDropped() const {
+            return numDropped;
+        }
+
         long long getNumDataIn() const {
             return numDataIn;
         }
@@ -77,7 +227,18 @@ class ClipBoard {
             return numDataOut;
         }
 
+        // Bytes and hits held by the blocks currently queued
+        std::size_t getBytes() const {
+            return bytesQueued;
+        }
+
+        std::size_t getHits() const {
+            return hitsQueued;
+        }
+
         bool empty() {
+            if(ring)
+                return ring->empty();
             std::lock_guard<std::mutex> lock(queueMutex);
             return rawEmpty();
         }
@@ -88,11 +249,23 @@ class ClipBoard {
 
         void finish() {
             doneFlag = true;
+            // a waiter between its check and its wait holds the mutex, so it cannot miss this
+            { std::lock_guard<std::mutex> lk(queueMutex); }
             cvNotEmpty.notify_all();
         }
 
+        // In ring mode the consumer registers in ringWaiters before it sleeps on
+        // cvNotEmpty, and the producer only takes the mutex to notify when it sees
+        // a waiter, so pushes stay lock-free while nobody waits
         void waitNotEmptyOrDone() {
           std::unique_lock<std::mutex> lk(queueMutex);
+          if(ring) {
+              ringWaiters++;
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+              cvNotEmpty.wait(lk, [&] { return doneFlag || !ring->empty(); } );
+              ringWaiters--;
+              return;
+          }
           cvNotEmpty.wait(lk,
                             [&] { return doneFlag || !rawEmpty(); } );
         }
@@ -100,6 +273,13 @@ class ClipBoard {
         template<typename Rep, typename TimeUnit>
         bool waitNotEmptyOrDoneOrTimeout(std::chrono::duration<Rep, TimeUnit> timeout) {
           std::unique_lock<std::mutex> lk(queueMutex);
+          if(ring) {
+              ringWaiters++;
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+              bool ready = cvNotEmpty.wait_for(lk, timeout, [&] { return doneFlag || !ring->empty(); } );
+              ringWaiters--;
+              return ready;
+          }
           return cvNotEmpty.wait_for(lk, timeout,
                             [&] { return doneFlag || !rawEmpty(); } );
         }
@@ -111,18 +291,88 @@ class ClipBoard {
         };
 
     private:
+        void accountOut(const std::deque<std::unique_ptr<T>> &drained) {
+            numDataOut += drained.size();
+            unaccount(drained);
+        }
+
+        void unaccount(const std::deque<std::unique_ptr<T>> &removed) {
+            std::size_t bytes = 0, hits = 0;
+            for(const auto &data : removed) {
+                bytes += ClipBoardFootprint<T>::bytes(*data);
+                hits += ClipBoardFootprint<T>::hits(*data);
+            }
+            bytesQueued -= bytes;
+            hitsQueued -= hits;
+        }
+
         bool rawEmpty() {
-            return dataQueue.empty();
+            return ring ? ring->empty() : dataQueue.empty();
         }
 
+        // The ring is bounded: a full ring applies back-pressure to the producer
+        // until the consumer catches up, or drops the block once finish() was called.
+        // Only for producers with a thread of their own, see tryPushData
+        void pushRing(std::unique_ptr<T> data) {
+            if(data == NULL)
+                return;
+            std::size_t bytes = ClipBoardFootprint<T>::bytes(*data);
+            std::size_t hits = ClipBoardFootprint<T>::hits(*data);
+            // account before publishing so the consumer never subtracts first
+            bytesQueued += bytes;
+            hitsQueued += hits;
+
+            unsigned spins = 0;
+            while(!ring->tryPush(data)) {
+                if(doneFlag) {
+                    bytesQueued -= bytes;
+                    hitsQueued -= hits;
+                    numDropped++;
+                    return;
+                }
+                if(++spins < 1024)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            published();
+        }
+
+        // After a block went into the ring: count it and wake whoever waits for it
+        void published() {
+            numDataIn++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(ringWaiters > 0) {
+                { std::lock_guard<std::mutex> lk(queueMutex); }
+                cvNotEmpty.notify_all();
+            }
+            notify();
+        }
+
+        void notify() {
+            int fd = notifyFd;
+            if(fd >= 0) {
+                uint64_t one = 1;
+                ssize_t ret = ::write(fd, &one, sizeof(one));
+                (void)ret; // counter saturation (EAGAIN) still leaves the fd readable
+            }
+        }
+
+        std::unique_ptr<SpscRing<T>> ring;
+
         std::condition_variable cvNotEmpty;
 
-        std::mutex queueMutex;
+        mutable std::mutex queueMutex;
         std::deque<std::unique_ptr<T>> dataQueue;
 
         std::atomic<bool> doneFlag;
         std::atomic<unsigned> numDataIn;
         std::atomic<unsigned> numDataOut;
+        std::atomic<std::size_t> bytesQueued;
+        std::atomic<std::size_t> hitsQueued;
+        std::atomic<unsigned> numDropped{0};
+        std::atomic<int> notifyFd{-1};
+        std::atomic<unsigned> ringWaiters{0}; // consumers sleeping on cvNotEmpty in ring mode
 };
 
 // template class ClipBoard<RawData>;
@@ -0,0 +1,94 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Task executors shared by the data loaders
+// # Comment: Work-stealing pool sized to the machine
+// #################################################
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Something that runs short tasks. Tasks must not block for long: a loader
+// submits one bounded unit of work ("decode the next chunk", "service this
+// socket once") and resubmits itself for the next one.
+class Executor {
+    public:
+        using Task = std::function<void()>;
+
+        virtual ~Executor() = default;
+
+        virtual void submit(Task task) = 0;
+
+        // Run task once delay has passed. owner is an opaque key for wakeDelayed.
+        virtual void submitAfter(std::chrono::microseconds delay, Task task, const void* owner = nullptr) = 0;
+
+        // Make all delayed tasks of owner due immediately (e.g. when stopping)
+        virtual void wakeDelayed(const void* owner) = 0;
+
+        virtual std::size_t concurrency() const = 0;
+};
+
+// Fixed set of workers, each with its own deque. Workers run their own queue
+// in submission order and steal from the others when it runs dry; tasks
+// submitted from outside the pool are spread round-robin. Delayed tasks sit in
+// a shared timer heap and are moved to a queue by the next worker to look,
+// between any two tasks, so they fall due even when no worker is idle.
+class WorkStealingPool : public Executor {
+    public:
+        // nThreads 0: one worker per hardware thread. onWorkerStart runs first on every
+        // worker, e.g. to pin it (affinity::pinCurrentThread)
+        explicit WorkStealingPool(std::size_t nThreads = 0, std::function<void(std::size_t)> onWorkerStart = nullptr);
+        ~WorkStealingPool() override;
+
+        WorkStealingPool(const WorkStealingPool &o) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool &o) = delete;
+
+        void submit(Task task) override;
+        void submitAfter(std::chrono::microseconds delay, Task task, const void* owner = nullptr) override;
+        void wakeDelayed(const void* owner) override;
+
+        std::size_t concurrency() const override { return workers.size(); }
+
+        std::size_t getNumSteals() const { return numSteals; }
+        std::size_t getNumExecuted() const { return numExecuted; }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        struct Delayed {
+            std::chrono::steady_clock::time_point due;
+            Task task;
+            const void* owner;
+        };
+
+        void workerLoop(std::size_t idx, std::function<void(std::size_t)> onWorkerStart);
+        bool tryRun(std::size_t idx);
+        void push(std::size_t idx, Task task);
+        bool releaseDue(std::size_t idx); // sleepMutex held
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+
+        std::atomic<std::size_t> nextQueue{0};
+        std::atomic<std::size_t> pending{0};  // tasks sitting in the queues
+        std::atomic<std::size_t> numSteals{0}, numExecuted{0};
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCv;
+        std::vector<Delayed> timers;          // min-heap on due, guarded by sleepMutex
+        bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SLOT_ALLOCATOR_H
+#define SLOT_ALLOCATOR_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Growable pool of slots with generational handles
+// # Comment: O(1) allocate and free, lowest free slot first
+// #################################################
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace viz{
+    // Names one allocation. A handle goes stale when its slot is freed: the slot's
+    // generation moves on, so a later owner of the same slot is never mistaken for it.
+    // Generations are odd while the slot is in use and even while it is free.
+    struct SlotHandle{
+        static constexpr std::uint32_t invalidIndex = std::numeric_limits<std::uint32_t>::max();
+
+        std::uint32_t index = invalidIndex;
+        std::uint32_t generation = 0;
+
+        bool isValid() const { return index != invalidIndex; }
+        bool operator==(const SlotHandle& o) const { return index == o.index && generation == o.generation; }
+        bool operator!=(const SlotHandle& o) const { return !(*this == o); }
+    };
+
+    // Slots of T handed out and taken back through a free bitmap that always yields the
+    // lowest free slot, so the live slots stay packed at the bottom of the pool and
+    // highWater() (one past the highest live slot) follows the live count down again
+    // after a burst. When allocations are freed in the order they were made, the freed
+    // slots are consecutive and so are the next allocations. When no slot is free the pool doubles,
+    // up to maxCapacity (0: unbounded); past that allocate() returns an invalid handle
+    // and the owner decides what to give up. Growing moves the slots, so hold on to
+    // handles, not pointers. Not thread safe.
+    //
+    // The bitmap has one bit per slot, set while the slot is free, and a summary with
+    // one bit per 64-bit word that has any free slot. The lowest free slot is two
+    // count-trailing-zeros away, and firstSummary keeps the search from re-reading
+    // summary words already known to be empty.
+    template <typename T>
+    class SlotAllocator{
+        public:
+            explicit SlotAllocator(std::size_t capacity = 1024, std::size_t arg_maxCapacity = 0) : maxCapacity(arg_maxCapacity) {
+                if(capacity == 0)
+                    throw std::invalid_argument("SlotAllocator capacity must be positive");
+                reserve(capacity);
+            }
+
+            SlotHandle allocate(){
+                if(numFree == 0 && !grow())
+                    return SlotHandle();
+
+                std::uint32_t index = lowestFree();
+                markUsed(index);
+                generations[index]++;
+                live++;
+                top = std::max<std::size_t>(top, index + 1);
+                return SlotHandle{index, generations[index]};
+            }
+
+            //Returns false if the handle was stale or invalid
+            bool free(SlotHandle h){
+                if(!isAlive(h))
+                    return false;
+                generations[h.index]++;
+                slots[h.index] = T();
+                markFree(h.index);
+                live--;
+                //every slot is counted down once for each time it was counted up
+                while(top > 0 && !(generations[top - 1] & 1))
+                    top--;
+                return true;
+            }
+
+            bool isAlive(SlotHandle h) const {
+                return h.index < slots.size() && generations[h.index] == h.generation && (h.generation & 1);
+            }
+
+            //nullptr for a stale handle
+            T* get(SlotHandle h){ return isAlive(h) ? &slots[h.index] : nullptr; }
+            const T* get(SlotHandle h) const { return isAlive(h) ? &slots[h.index] : nullptr; }
+
+            //Grows to at least capacity slots, but never past maxCapacity
+            void reserve(std::size_t capacity){
+                if(maxCapacity != 0)
+                    capacity = std::min(capacity, maxCapacity);
+                if(capacity <= slots.size())
+                    return;
+                if(capacity > SlotHandle::invalidIndex)
+                    throw std::length_error("SlotAllocator capacity exceeds the handle range");
+
+                std::size_t old = slots.size();
+                slots.resize(capacity);
+                generations.resize(capacity, 0);
+                freeBits.resize((capacity + 63) / 64, 0);
+                freeSummary.resize((freeBits.size() + 63) / 64, 0);
+                for(std::size_t i = old; i < capacity; i++)
+                    markFree((std::uint32_t)i);
+            }
+
+            //Slots already reserved are kept, so set it before reserving
+            void setMaxCapacity(std::size_t arg_maxCapacity){ maxCapacity = arg_maxCapacity; }
+
+            std::size_t size() const { return live; }
+            std::size_t highWater() const { return top; } //every live slot is below this
+            std::size_t capacity() const { return slots.size(); }
+            std::size_t getMaxCapacity() const { return maxCapacity; }
+            bool isFull() const { return numFree == 0 && maxCapacity != 0 && slots.size() >= maxCapacity; }
+
+        private:
+            //Only called with a free slot left
+            std::uint32_t lowestFree(){
+                while(freeSummary[firstSummary] == 0)
+                    firstSummary++;
+                std::size_t word = firstSummary * 64 + __builtin_ctzll(freeSummary[firstSummary]);
+                return (std::uint32_t)(word * 64 + __builtin_ctzll(freeBits[word]));
+            }
+
+            void markFree(std::uint32_t index){
+                std::size_t word = index / 64;
+                freeBits[word] |= std::uint64_t(1) << (index % 64);
+                freeSummary[word / 64] |= std::uint64_t(1) << (word % 64);
+                firstSummary = std::min(firstSummary, word / 64);
+                numFree++;
+            }
+
+            void markUsed(std::uint32_t index){
+                std::size_t word = index / 64;
+                freeBits[word] &= ~(std::uint64_t(1) << (index % 64));
+                if(freeBits[word] == 0)
+                    freeSummary[word / 64] &= ~(std::uint64_t(1) << (word % 64));
+                numFree--;
+            }
+
+            bool grow(){
+                std::size_t limit = maxCapacity != 0 ? maxCapacity : (std::size_t)SlotHandle::invalidIndex;
+                if(slots.size() >= limit)
+                    return false;
+                reserve(std::min(limit, std::max<std::size_t>(1, 2 * slots.size())));
+                return true;
+            }
+
+            std::vector<T> slots;
+            std::vector<std::uint32_t> generations;
+            std::vector<std::uint64_t> freeBits;    //bit set: slot free
+            std::vector<std::uint64_t> freeSummary; //bit set: that word of freeBits has a free slot
+            std::size_t firstSummary = 0;           //every summary word below this is empty
+            std::size_t numFree = 0;
+            std::size_t live = 0;
+            std::size_t top = 0;
+            std::size_t maxCapacity;
+    };
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Lock-free single-producer/single-consumer ring
+// # Comment: Bounded alternative to the ClipBoard deque
+// #################################################
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+// Exactly one thread may call tryPush and exactly one (other) thread may call
+// tryPop. Indices grow monotonically; each side keeps a cached copy of the
+// other side's index so the shared cache lines are only touched when the ring
+// looks full (producer) or empty (consumer).
+template <class T>
+class SpscRing {
+    public:
+        static constexpr std::size_t cacheLine = 64;
+
+        explicit SpscRing(std::size_t minCapacity) {
+            std::size_t cap = 2;
+            while(cap < minCapacity)
+                cap <<= 1;
+            slots.resize(cap);
+            mask = cap - 1;
+        }
+
+        SpscRing(const SpscRing &o) = delete;
+        SpscRing& operator=(const SpscRing &o) = delete;
+
+        // Producer side. On success ownership is taken and data is left empty;
+        // if the ring is full data is left untouched and false is returned.
+        bool tryPush(std::unique_ptr<T> &data) {
+            const std::size_t t = tail.load(std::memory_order_relaxed);
+            if(t - cachedHead == slots.size()) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if(t - cachedHead == slots.size())
+                    return false;
+            }
+            slots[t & mask] = std::move(data);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns nullptr if the ring is empty.
+        std::unique_ptr<T> tryPop() {
+            const std::size_t h = head.load(std::memory_order_relaxed);
+            if(h == cachedTail) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if(h == cachedTail)
+                    return nullptr;
+            }
+            std::unique_ptr<T> tmp = std::move(slots[h & mask]);
+            head.store(h + 1, std::memory_order_release);
+            return tmp;
+        }
+
+        // Approximate when called concurrently with push/pop. head is read first:
+        // tail only grows, so the difference cannot wrap below zero, and a stale
+        // head can only overshoot, which the clamp absorbs.
+        std::size_t size() const {
+            const std::size_t h = head.load(std::memory_order_acquire);
+            const std::size_t t = tail.load(std::memory_order_acquire);
+            if(t < h)
+                return 0;
+            return t - h > slots.size() ? slots.size() : t - h;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        std::size_t capacity() const {
+            return slots.size();
+        }
+
+    private:
+        std::vector<std::unique_ptr<T>> slots;
+        std::size_t mask;
+
+        alignas(cacheLine) std::atomic<std::size_t> head{0}; // next slot to pop, written by consumer
+        std::size_t cachedTail = 0;                           // consumer's copy of tail
+        alignas(cacheLine) std::atomic<std::size_t> tail{0}; // next slot to fill, written by producer
+        std::size_t cachedHead = 0;                           // producer's copy of head
+};
+
+#endif
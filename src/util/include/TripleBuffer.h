@@ -0,0 +1,64 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// #################################################
+// # Project: YARR-event-visualizer
+// # Description: Lock-free triple buffer
+// # Comment: Hands the latest snapshot from one producer thread to one consumer
+// #################################################
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// The producer fills back() and calls publish(); the consumer calls update()
+// and reads front(). Neither side ever blocks: the producer always has a free
+// slot to write, and the consumer always sees the most recently published
+// snapshot (intermediate ones are overwritten, never queued). Slots are reused,
+// so containers inside T keep their capacity from one round to the next.
+template <class T>
+class TripleBuffer {
+    public:
+        static constexpr std::size_t cacheLine = 64;
+
+        TripleBuffer() = default;
+        TripleBuffer(const TripleBuffer &o) = delete;
+        TripleBuffer& operator=(const TripleBuffer &o) = delete;
+
+        // Producer side
+        T& back() {
+            return slots[backIdx];
+        }
+
+        void publish() {
+            backIdx = middle.exchange(backIdx | dirtyBit, std::memory_order_acq_rel) & indexMask;
+        }
+
+        // Consumer side. Returns true if a newer snapshot was swapped to the front.
+        bool update() {
+            if(!(middle.load(std::memory_order_relaxed) & dirtyBit))
+                return false;
+            frontIdx = middle.exchange(frontIdx, std::memory_order_acq_rel) & indexMask;
+            return true;
+        }
+
+        T& front() {
+            return slots[frontIdx];
+        }
+
+        const T& front() const {
+            return slots[frontIdx];
+        }
+
+    private:
+        static constexpr std::uint8_t dirtyBit = 0x4;
+        static constexpr std::uint8_t indexMask = 0x3;
+
+        std::array<T, 3> slots;
+
+        alignas(cacheLine) std::uint8_t backIdx = 0;             // producer only
+        alignas(cacheLine) std::atomic<std::uint8_t> middle{1};  // last published slot, plus dirty bit
+        alignas(cacheLine) std::uint8_t frontIdx = 2;            // consumer only
+};
+
+#endif
@@ -15,10 +15,17 @@
 #include <getopt.h>
 #include <fstream>
 #include <map>
+#include <deque>
+#include <chrono>
+#include <atomic>
 
 #include "logging.h"
 #include "AllDataLoaders.h"
 #include "DataBase.h"
+#include "EventBuilder.h"
+#include "ShardedEventBuilder.h"
+#include "Executor.h"
+#include "Affinity.h"
 
 namespace cli_helpers {
     extern std::shared_ptr<spdlog::logger> logger;
@@ -55,6 +62,20 @@ enum CLIstate {
     RECONSTRUCT
 };
 
+//Bytes and hits of one source held at each stage between the wire and the screen
+struct MemoryStats {
+    std::size_t loaderBytes = 0, loaderHits = 0;       //batch being filled by the DataLoader
+    std::size_t clipboardBytes = 0, clipboardHits = 0; //blocks queued in the ClipBoard
+    std::size_t clipboardBlocks = 0;
+    std::size_t builderBytes = 0, builderHits = 0;     //uncompleted bunches held by the event builder
+    std::size_t consumerBytes = 0, consumerHits = 0;   //reported by the consumer (e.g. Detector particles)
+    std::size_t budget = 0;                            //"memory_budget" of the source in bytes, 0 if unset
+
+    std::size_t totalBytes() const { return loaderBytes + clipboardBytes + builderBytes + consumerBytes; }
+    std::size_t totalHits() const { return loaderHits + clipboardHits + builderHits + consumerHits; }
+    bool overBudget() const { return budget > 0 && totalBytes() > budget; }
+};
+
 class VisualizerCli {
     public:
         VisualizerCli();
@@ -74,12 +95,21 @@ class VisualizerCli {
         const json& getConfig(std::string fe_id) const;
         const json& getMasterConfig() {return config;}
 
+        // Thread placement from viz_config.placement.<role>; unpinned if not configured
+        affinity::Placement getPlacement(const std::string& role) const;
+        void pinCurrentThread(const std::string& role) const; //applies and logs the placement of role
+
         std::unique_ptr<std::vector<pixelHit>> getData(int fe_id, bool get_all=false) const;
         std::unique_ptr<std::vector<pixelHit>> getData(std::string fe_id, bool get_all=false) const;
 
-        std::unique_ptr<std::vector<Event>> getEvents(int fe_id, bool get_all=false) const;
-        std::unique_ptr<std::vector<Event>> getEvents(std::string fe_id, bool get_all=false) const;
+        //Ownership of the whole batch is given to the user; arena-backed batches are released when it is dropped
+        std::unique_ptr<EventData> getEvents(int fe_id, bool get_all=false) const;
+        std::unique_ptr<EventData> getEvents(std::string fe_id, bool get_all=false) const;
 
+        //Every pending block of a source, handed over with one clipboard lock acquisition and without concatenation
+        std::deque<std::unique_ptr<EventData>> getBlocks(int fe_id, bool get_all=true) const;
+
+        //Bunches the event builder has completed since the last call, oldest bcid first; nullptr if there are none
         std::unique_ptr<std::vector<ReconstructedBunch>> getReconstructedBunch();
 
         // std::vector<std::vector<int>> getProcessedData(int fe_id); // row, column for all hits in the EventData object
@@ -91,6 +121,15 @@ class VisualizerCli {
         // # events
         // getSingleBatch();
 
+        // Memory accounting, per source
+        MemoryStats getMemoryStats(int fe_id) const;
+        void setConsumerMemory(int fe_id, std::size_t bytes, std::size_t hits);
+
+        // Readiness: one eventfd is signalled whenever any FE pushes a block
+        bool waitForData(std::chrono::microseconds timeout) const;  //true if some FE has data, false on timeout/interrupt/stop()
+        bool hasData(int fe_id) const;
+        int getNotifyFd() const { return notifyFd; }  //for integration into an external poll/epoll loop
+
         size_t  getTotalFEs() const {return clipboards.size();}
         bool isRunning() const { return started; }
 
@@ -98,33 +137,34 @@ class VisualizerCli {
         int parseOptions(int argc, char *argv[]);
         void printHelp();
 
-        bool started = false;
+        std::atomic<bool> started{false};  //read by consumer threads (e.g. Detector processing)
+        std::atomic<bool> stopping{false}; //set by stop() before it wakes waitForData
         bool firstTime = true;
 
-        uint32_t nHits = 0;
-
         std::unique_ptr<EventData> getRawData(int fe_id) const;
         std::unique_ptr<EventData> getRawData(std::string fe_id) const;
 
-        std::unique_ptr<std::vector<Event>> loadEvents(int fe_id, bool get_all = false) const;
-        std::unique_ptr<std::vector<Event>> loadEvents(std::string fe_id, bool get_all = false) const;
+        std::deque<std::unique_ptr<EventData>> drainBlocks(int fe_id, bool get_all = false) const;
+        std::unique_ptr<EventData> loadEvents(int fe_id, bool get_all = false) const;
+        std::unique_ptr<EventData> loadEvents(std::string fe_id, bool get_all = false) const;
         
         cli_helpers::ScanOpts scanOpts;
         
         json config;
         std::vector<std::unique_ptr<DataLoader>> dataLoaders;
+        std::map<std::string, std::shared_ptr<WorkStealingPool>> loaderPools; //one per distinct loader placement, shared by loaders with "executor": "pool"
+        std::map<std::string, affinity::Placement> rolePlacements;             //viz_config.placement: "loaders", "builder", "render"
         std::vector<std::shared_ptr<ClipBoard<EventData>>> clipboards;
         std::map<std::string, int> feIdMap;
         std::vector<int> configIdMap;
         std::vector<std::string> names;
+        std::vector<std::size_t> memoryBudgets;
+        int notifyFd = -1;
+        //Written by the thread running the event builder and the consuming thread, read by getMemoryStats from any thread
+        std::vector<std::atomic<std::size_t>> builderBytes, builderHits;
+        std::vector<std::atomic<std::size_t>> consumerBytes, consumerHits;
 
-
-        std::unique_ptr<std::vector<ReconstructedBunch>> uncompletedReconEvents; //Buffer containing uncompleted reconstructed events from the last getReconstructedEvents() call
-        std::vector<uint32_t> curr_fe_bcid;
-        uint32_t firstuncompleted_bcid = 0,  firstuntouched_bcid = 0; //Smallest bcid of reconstructed event that is in the process of reconstruction, smallest bcid of first reconstructed event that has
-
-
-        uint16_t numloops = 0;
+        std::unique_ptr<EventBuilder> builder; //viz_config.event_builder, sharded with "threads" > 1; driven by getReconstructedBunch()
 };
 
 #endif
\ No newline at end of file
@@ -1,48 +1,50 @@
 #ifndef MATHTOOLS_H
 #define MATHTOOLS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include "DataBase.h"
-// #include <glm/vec3.hpp>
-
-// TODO: make a function converting batches of EventData from input into
-//       things that can be rendered in OpenGL
-//       (don't worry about rotation matricies for now)
-//
-// std::vector<glm::vec4> hits convertBatch(EventData* input) {
-//     std::vector<glm::vec4*> ret;
-//     ret.reserve(2*input->size());
-//     for(Event event : input->events) {
-//         for(Hit hit : event.hits) {
-//             hit.row, hit.col // access with these variables
-//         }
-//     }
-
-//     return ret;
-// }
+
+namespace viz{
+    // Pixel to world map of one chip: world = origin + row * rowStep + col * colStep.
+    // It only depends on the chip geometry, so it is computed once per chip (see
+    // Detector) instead of once per hit.
+    struct PixelTransform {
+        float origin[3] = {0.0f, 0.0f, 0.0f};
+        float rowStep[3] = {0.0f, 0.0f, 0.0f};
+        float colStep[3] = {0.0f, 0.0f, 0.0f};
+    };
+
+    // Maps n pixels of one chip to world positions, written as separate x, y and z arrays.
+    // Uses SSE2 four pixels at a time when the target has it; the result is the same as
+    // transformPixelsScalar to the last bit either way.
+    void transformPixels(const PixelTransform& t, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n, float* x, float* y, float* z);
+    void transformPixelsScalar(const PixelTransform& t, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n, float* x, float* y, float* z);
+}
 
 #endif
 
 
 
 /*
-// Reference python function: 
+// Reference python function:
 
 def to_space(rvec, pos, theta, dim=None, zero_center=False):
     """Convert pixel vector <rvec> (2xN) to space points (3xN), using chip position <pos> (3) and euler angles <theta> (3)
     """
-    
+
     theta = np.array(theta)*np.pi/180.0
     # pad with zeros
     if zero_center:
         assert dim is not None, "Must pass dimension if zero-centering!"
         rvec = np.array(rvec) - (np.array(dim)/2)[:,None]
-        
+
     rvec = np.pad(np.array(rvec), [[0,1], [0,0]])*0.05 # mm/pixel
     rot_matrix = Rzyx(*theta)
     rot = np.matmul(rot_matrix, rvec)
     p = np.array(pos)[:,None] + rot
-    
+
     return p
 
-*/
\ No newline at end of file
+*/
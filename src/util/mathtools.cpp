@@ -1,2 +1,44 @@
 #include "mathtools.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VIZ_HAVE_SSE2
+#endif
+
+namespace viz{
+    // Both versions evaluate (origin + row * rowStep) + col * colStep in that order, so they agree exactly
+    void transformPixelsScalar(const PixelTransform& t, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n, float* x, float* y, float* z){
+        for(std::size_t i = 0; i < n; i++){
+            float r = rows[i], c = cols[i];
+            x[i] = (t.origin[0] + r * t.rowStep[0]) + c * t.colStep[0];
+            y[i] = (t.origin[1] + r * t.rowStep[1]) + c * t.colStep[1];
+            z[i] = (t.origin[2] + r * t.rowStep[2]) + c * t.colStep[2];
+        }
+    }
+
+#ifdef VIZ_HAVE_SSE2
+    void transformPixels(const PixelTransform& t, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n, float* x, float* y, float* z){
+        const __m128 o[3] = {_mm_set1_ps(t.origin[0]), _mm_set1_ps(t.origin[1]), _mm_set1_ps(t.origin[2])};
+        const __m128 rs[3] = {_mm_set1_ps(t.rowStep[0]), _mm_set1_ps(t.rowStep[1]), _mm_set1_ps(t.rowStep[2])};
+        const __m128 cs[3] = {_mm_set1_ps(t.colStep[0]), _mm_set1_ps(t.colStep[1]), _mm_set1_ps(t.colStep[2])};
+        float* out[3] = {x, y, z};
+        const __m128i zero = _mm_setzero_si128();
+
+        std::size_t i = 0;
+        for(; i + 4 <= n; i += 4){
+            // four 16 bit pixel indices, widened to 32 bit ints and then to floats
+            __m128i r16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows + i));
+            __m128i c16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(cols + i));
+            __m128 r = _mm_cvtepi32_ps(_mm_unpacklo_epi16(r16, zero));
+            __m128 c = _mm_cvtepi32_ps(_mm_unpacklo_epi16(c16, zero));
+            for(int k = 0; k < 3; k++)
+                _mm_storeu_ps(out[k] + i, _mm_add_ps(_mm_add_ps(o[k], _mm_mul_ps(r, rs[k])), _mm_mul_ps(c, cs[k])));
+        }
+        transformPixelsScalar(t, rows + i, cols + i, n - i, x + i, y + i, z + i);
+    }
+#else
+    void transformPixels(const PixelTransform& t, const std::uint16_t* rows, const std::uint16_t* cols, std::size_t n, float* x, float* y, float* z){
+        transformPixelsScalar(t, rows, cols, n, x, y, z);
+    }
+#endif
+}